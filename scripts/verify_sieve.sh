@@ -10,7 +10,12 @@ echo "[HOOK] Sieve verification: rebuilding..."
 ./build.sh -r glm5_seastar_prime 2>&1 | tail -1
 
 echo "[HOOK] Running 2B integer verification..."
-OUTPUT=$(./build/release/glm5_seastar_prime -t 10000 -n 200000 -c 4 --logger-ostream-type none 2>/dev/null)
+# The prime cache stores sieve output, so it is only used when explicitly requested
+CACHE_ARGS=()
+if [ -n "${PRIME_CACHE_DIR:-}" ]; then
+    CACHE_ARGS=(--cache-dir "$PRIME_CACHE_DIR")
+fi
+OUTPUT=$(./build/release/glm5_seastar_prime -t 10000 -n 200000 -c 4 "${CACHE_ARGS[@]}" --logger-ostream-type none 2>/dev/null)
 PRIMES=$(echo "$OUTPUT" | grep "素数总数" | grep -o '[0-9]*' | tail -1)
 MS=$(echo "$OUTPUT" | grep "计算耗时" | grep -o '[0-9]*' | tail -1)
 
@@ -0,0 +1,89 @@
+#!/bin/bash
+# Verify big_file_splitter and big_file_joiner round-trip a file byte for byte.
+# Splits a random, not page-aligned input with each chunk layout, joins the
+# chunks back through the manifest and compares the result with the input.
+# Expected: every mode reproduces the input and the joiner's CRC32C check passes
+
+set -euo pipefail
+cd "$(git -C "$(dirname "$0")/.." rev-parse --show-toplevel)"
+
+echo "[HOOK] Split/join verification: rebuilding..."
+./build.sh -r big_file_splitter 2>&1 | tail -1
+./build.sh -r big_file_joiner 2>&1 | tail -1
+
+SPLITTER="$PWD/build/release/big_file_splitter"
+JOINER="$PWD/build/release/big_file_joiner"
+CORES="${SPLIT_JOIN_CORES:-4}"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# 37 MiB plus an odd tail, so the last chunk and the last page are partial
+INPUT="$WORK/input"
+dd if=/dev/urandom of="$INPUT" bs=1M count=37 status=none
+head -c 12345 /dev/urandom >> "$INPUT"
+# a line-structured copy for --split-on newline
+TEXT="$WORK/input.txt"
+base64 "$INPUT" > "$TEXT"
+
+MODES=(
+    "default||"
+    "pipeline||--pipeline"
+    "chunk-size||--chunk-size 5M"
+    "chunks||--chunks 7"
+    "split-on newline|text|--split-on newline"
+    "cdc||--cdc 256K:1M:4M"
+    "zero-copy||--chunk-size 8M --zero-copy"
+)
+
+FAILED=0
+for MODE in "${MODES[@]}"; do
+    IFS='|' read -r NAME KIND ARGS <<< "$MODE"
+    SOURCE="$INPUT"
+    if [ "$KIND" = "text" ]; then
+        SOURCE="$TEXT"
+    fi
+
+    DIR="$WORK/$(echo "$NAME" | tr ' ' '-')"
+    mkdir -p "$DIR"
+    # shellcheck disable=SC2086
+    if ! (cd "$DIR" && "$SPLITTER" --input "$SOURCE" -m 64M -c "$CORES" $ARGS \
+            --logger-ostream-type none > /dev/null 2>&1); then
+        echo "[HOOK] FAIL: $NAME: big_file_splitter failed"
+        FAILED=1
+        continue
+    fi
+    if ! "$JOINER" --manifest "$DIR/chunks.manifest" --output "$DIR/joined" \
+            -m 64M -c "$CORES" --logger-ostream-type none > /dev/null 2>&1; then
+        echo "[HOOK] FAIL: $NAME: big_file_joiner failed"
+        FAILED=1
+        continue
+    fi
+    if ! cmp -s "$SOURCE" "$DIR/joined"; then
+        echo "[HOOK] FAIL: $NAME: joined file differs from the input"
+        FAILED=1
+        continue
+    fi
+    CHUNKS=$(grep -vc '^#' "$DIR/chunks.manifest")
+    echo "[HOOK] $NAME: $CHUNKS chunks OK"
+done
+
+# a chunk whose bytes changed must be rejected by the CRC32C check
+DIR="$WORK/chunk-size"
+if [ -d "$DIR" ]; then
+    CHUNK="$DIR/$(grep -v '^#' "$DIR/chunks.manifest" | head -1 | cut -d' ' -f1)"
+    printf 'corrupted bytes!' | dd of="$CHUNK" bs=1 seek=100 conv=notrunc status=none
+    if "$JOINER" --manifest "$DIR/chunks.manifest" --output "$DIR/joined" \
+            -m 64M -c "$CORES" --logger-ostream-type none > /dev/null 2>&1; then
+        echo "[HOOK] FAIL: corrupted chunk was joined without error"
+        FAILED=1
+    else
+        echo "[HOOK] corrupted chunk rejected OK"
+    fi
+fi
+
+if [ "$FAILED" -ne 0 ]; then
+    exit 1
+fi
+
+echo "[HOOK] PASS: split/join round trip verified"
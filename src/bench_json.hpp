@@ -0,0 +1,357 @@
+#pragma once
+// Minimal JSON value, serializer and parser for prime_bench result files.
+// Only what the benchmark needs: objects keep insertion order, numbers are
+// doubles (exact for integers below 2^53), strings are UTF-8 passthrough with
+// the standard escapes.
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace json {
+
+class Value {
+public:
+    enum class Type { null, boolean, number, string, array, object };
+
+    Value() = default;
+    Value(bool b) : type_(Type::boolean), bool_(b) {}
+    Value(double d) : type_(Type::number), number_(d) {}
+    Value(int v) : Value(static_cast<double>(v)) {}
+    Value(long v) : Value(static_cast<double>(v)) {}
+    Value(unsigned v) : Value(static_cast<double>(v)) {}
+    Value(unsigned long v) : Value(static_cast<double>(v)) {}
+    Value(unsigned long long v) : Value(static_cast<double>(v)) {}
+    Value(long long v) : Value(static_cast<double>(v)) {}
+    Value(std::string s) : type_(Type::string), string_(std::move(s)) {}
+    Value(const char* s) : Value(std::string(s)) {}
+
+    static Value array() { Value v; v.type_ = Type::array; return v; }
+    static Value object() { Value v; v.type_ = Type::object; return v; }
+
+    Type type() const noexcept { return type_; }
+    bool is_null() const noexcept { return type_ == Type::null; }
+    bool is_number() const noexcept { return type_ == Type::number; }
+    bool is_string() const noexcept { return type_ == Type::string; }
+    bool is_array() const noexcept { return type_ == Type::array; }
+    bool is_object() const noexcept { return type_ == Type::object; }
+
+    bool as_bool(bool fallback = false) const noexcept {
+        return type_ == Type::boolean ? bool_ : fallback;
+    }
+    double as_number(double fallback = 0.0) const noexcept {
+        return type_ == Type::number ? number_ : fallback;
+    }
+    const std::string& as_string() const noexcept { return string_; }
+    const std::vector<Value>& items() const noexcept { return array_; }
+    const std::vector<std::pair<std::string, Value>>& members() const noexcept { return object_; }
+
+    void push_back(Value v) {
+        if (type_ != Type::array) *this = array();
+        array_.push_back(std::move(v));
+    }
+
+    // 对象成员访问：不存在则追加
+    Value& operator[](const std::string& key) {
+        if (type_ != Type::object) *this = object();
+        for (auto& [k, v] : object_) {
+            if (k == key) return v;
+        }
+        object_.emplace_back(key, Value());
+        return object_.back().second;
+    }
+
+    const Value* find(std::string_view key) const noexcept {
+        if (type_ != Type::object) return nullptr;
+        for (const auto& [k, v] : object_) {
+            if (k == key) return &v;
+        }
+        return nullptr;
+    }
+
+private:
+    Type type_ = Type::null;
+    bool bool_ = false;
+    double number_ = 0.0;
+    std::string string_;
+    std::vector<Value> array_;
+    std::vector<std::pair<std::string, Value>> object_;
+};
+
+namespace detail {
+
+inline void dump_string(std::string& out, const std::string& s) {
+    out.push_back('"');
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out.push_back(static_cast<char>(c));
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+inline void dump_number(std::string& out, double d) {
+    char buf[32];
+    // 整数值按整数输出，避免 1e+05 这类写法
+    if (d < 9007199254740992.0 && d > -9007199254740992.0 && d == static_cast<double>(static_cast<int64_t>(d))) {
+        auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), static_cast<int64_t>(d));
+        out.append(buf, ptr);
+        return;
+    }
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), d);
+    if (ec != std::errc()) {
+        out += "0";
+        return;
+    }
+    out.append(buf, ptr);
+}
+
+inline void dump_value(std::string& out, const Value& v, int indent, int depth) {
+    auto newline = [&](int d) {
+        if (indent <= 0) return;
+        out.push_back('\n');
+        out.append(static_cast<size_t>(indent * d), ' ');
+    };
+    switch (v.type()) {
+        case Value::Type::null: out += "null"; break;
+        case Value::Type::boolean: out += v.as_bool() ? "true" : "false"; break;
+        case Value::Type::number: dump_number(out, v.as_number()); break;
+        case Value::Type::string: dump_string(out, v.as_string()); break;
+        case Value::Type::array: {
+            out.push_back('[');
+            bool first = true;
+            for (const auto& item : v.items()) {
+                if (!first) out.push_back(',');
+                first = false;
+                newline(depth + 1);
+                dump_value(out, item, indent, depth + 1);
+            }
+            if (!v.items().empty()) newline(depth);
+            out.push_back(']');
+            break;
+        }
+        case Value::Type::object: {
+            out.push_back('{');
+            bool first = true;
+            for (const auto& [key, item] : v.members()) {
+                if (!first) out.push_back(',');
+                first = false;
+                newline(depth + 1);
+                dump_string(out, key);
+                out += indent > 0 ? ": " : ":";
+                dump_value(out, item, indent, depth + 1);
+            }
+            if (!v.members().empty()) newline(depth);
+            out.push_back('}');
+            break;
+        }
+    }
+}
+
+class Parser {
+public:
+    explicit Parser(std::string_view text) : text_(text) {}
+
+    std::optional<Value> parse(std::string* error) {
+        auto v = parse_value();
+        skip_ws();
+        if (v && pos_ != text_.size()) {
+            fail("trailing characters");
+            v.reset();
+        }
+        if (!v && error) *error = error_ + " at offset " + std::to_string(pos_);
+        return v;
+    }
+
+private:
+    std::optional<Value> parse_value() {
+        skip_ws();
+        if (pos_ >= text_.size()) return fail("unexpected end of input");
+        char c = text_[pos_];
+        if (c == '{') return parse_object();
+        if (c == '[') return parse_array();
+        if (c == '"') {
+            auto s = parse_string();
+            if (!s) return std::nullopt;
+            return Value(std::move(*s));
+        }
+        if (consume_literal("true")) return Value(true);
+        if (consume_literal("false")) return Value(false);
+        if (consume_literal("null")) return Value();
+        return parse_number();
+    }
+
+    std::optional<Value> parse_object() {
+        ++pos_;  // '{'
+        Value obj = Value::object();
+        skip_ws();
+        if (peek() == '}') {
+            ++pos_;
+            return obj;
+        }
+        while (true) {
+            skip_ws();
+            if (peek() != '"') return fail("expected object key");
+            auto key = parse_string();
+            if (!key) return std::nullopt;
+            skip_ws();
+            if (peek() != ':') return fail("expected ':'");
+            ++pos_;
+            auto v = parse_value();
+            if (!v) return std::nullopt;
+            obj[*key] = std::move(*v);
+            skip_ws();
+            if (peek() == ',') { ++pos_; continue; }
+            if (peek() == '}') { ++pos_; return obj; }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    std::optional<Value> parse_array() {
+        ++pos_;  // '['
+        Value arr = Value::array();
+        skip_ws();
+        if (peek() == ']') {
+            ++pos_;
+            return arr;
+        }
+        while (true) {
+            auto v = parse_value();
+            if (!v) return std::nullopt;
+            arr.push_back(std::move(*v));
+            skip_ws();
+            if (peek() == ',') { ++pos_; continue; }
+            if (peek() == ']') { ++pos_; return arr; }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    std::optional<std::string> parse_string() {
+        ++pos_;  // '"'
+        std::string s;
+        while (pos_ < text_.size()) {
+            char c = text_[pos_++];
+            if (c == '"') return s;
+            if (c != '\\') {
+                s.push_back(c);
+                continue;
+            }
+            if (pos_ >= text_.size()) break;
+            char e = text_[pos_++];
+            switch (e) {
+                case '"': s.push_back('"'); break;
+                case '\\': s.push_back('\\'); break;
+                case '/': s.push_back('/'); break;
+                case 'b': s.push_back('\b'); break;
+                case 'f': s.push_back('\f'); break;
+                case 'n': s.push_back('\n'); break;
+                case 'r': s.push_back('\r'); break;
+                case 't': s.push_back('\t'); break;
+                case 'u': {
+                    if (pos_ + 4 > text_.size()) break;
+                    unsigned code = 0;
+                    auto [p, ec] = std::from_chars(text_.data() + pos_, text_.data() + pos_ + 4, code, 16);
+                    if (ec != std::errc() || p != text_.data() + pos_ + 4) {
+                        fail("invalid \\u escape");
+                        return std::nullopt;
+                    }
+                    pos_ += 4;
+                    append_utf8(s, code);
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+                    return std::nullopt;
+            }
+        }
+        fail("unterminated string");
+        return std::nullopt;
+    }
+
+    std::optional<Value> parse_number() {
+        size_t begin = pos_;
+        while (pos_ < text_.size()) {
+            char c = text_[pos_];
+            if (std::isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '+' ||
+                c == '.' || c == 'e' || c == 'E') {
+                ++pos_;
+            } else {
+                break;
+            }
+        }
+        if (begin == pos_) return fail("unexpected character");
+        double d = 0.0;
+        auto [p, ec] = std::from_chars(text_.data() + begin, text_.data() + pos_, d);
+        if (ec != std::errc() || p != text_.data() + pos_) return fail("invalid number");
+        return Value(d);
+    }
+
+    static void append_utf8(std::string& s, unsigned code) {
+        if (code < 0x80) {
+            s.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            s.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            s.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            s.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+
+    bool consume_literal(std::string_view lit) {
+        if (text_.substr(pos_, lit.size()) == lit) {
+            pos_ += lit.size();
+            return true;
+        }
+        return false;
+    }
+
+    void skip_ws() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+    }
+
+    char peek() const { return pos_ < text_.size() ? text_[pos_] : '\0'; }
+
+    std::nullopt_t fail(const char* msg) {
+        if (error_.empty()) error_ = msg;
+        return std::nullopt;
+    }
+
+    std::string_view text_;
+    size_t pos_ = 0;
+    std::string error_;
+};
+
+} // namespace detail
+
+inline std::string dump(const Value& v, int indent = 2) {
+    std::string out;
+    detail::dump_value(out, v, indent, 0);
+    out.push_back('\n');
+    return out;
+}
+
+inline std::optional<Value> parse(std::string_view text, std::string* error = nullptr) {
+    return detail::Parser(text).parse(error);
+}
+
+} // namespace json
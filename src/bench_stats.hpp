@@ -0,0 +1,169 @@
+#pragma once
+// Descriptive statistics and significance tests for prime_bench samples.
+// Percentiles use linear interpolation between closest ranks; confidence
+// intervals come from a percentile bootstrap with a fixed seed so that the
+// same samples always produce the same report.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace bench {
+
+// 重采样次数与置信水平
+constexpr int kBootstrapResamples = 2000;
+constexpr double kConfidence = 0.95;
+// 少于该样本数时不做显著性判断
+constexpr size_t kMinSamplesForVerdict = 3;
+
+struct Summary {
+    size_t n = 0;
+    double min = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double mean = 0.0;
+    double stddev = 0.0;   // 样本标准差 (n-1)
+    double ci_low = 0.0;   // 中位数的 bootstrap 置信区间
+    double ci_high = 0.0;
+};
+
+// 已排序样本的分位数，q ∈ [0, 1]
+inline double percentile_sorted(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    if (sorted.size() == 1) return sorted.front();
+    double pos = q * static_cast<double>(sorted.size() - 1);
+    size_t lo = static_cast<size_t>(std::floor(pos));
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    double frac = pos - static_cast<double>(lo);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * frac;
+}
+
+inline double median_of(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return percentile_sorted(samples, 0.5);
+}
+
+namespace detail {
+
+// 对样本有放回重采样，返回重采样中位数
+inline double resample_median(const std::vector<double>& samples,
+                              std::mt19937_64& rng, std::vector<double>& scratch) {
+    std::uniform_int_distribution<size_t> pick(0, samples.size() - 1);
+    scratch.resize(samples.size());
+    for (auto& v : scratch) v = samples[pick(rng)];
+    size_t mid = scratch.size() / 2;
+    std::nth_element(scratch.begin(), scratch.begin() + mid, scratch.end());
+    double upper = scratch[mid];
+    if (scratch.size() % 2 == 1) return upper;
+    double lower = *std::max_element(scratch.begin(), scratch.begin() + mid);
+    return (lower + upper) / 2.0;
+}
+
+} // namespace detail
+
+inline Summary summarize(const std::vector<double>& samples, uint64_t seed = 0x5eed) {
+    Summary s;
+    s.n = samples.size();
+    if (samples.empty()) return s;
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    s.min = sorted.front();
+    s.median = percentile_sorted(sorted, 0.5);
+    s.p95 = percentile_sorted(sorted, 0.95);
+
+    double sum = 0.0;
+    for (double v : sorted) sum += v;
+    s.mean = sum / static_cast<double>(s.n);
+    if (s.n > 1) {
+        double sq = 0.0;
+        for (double v : sorted) sq += (v - s.mean) * (v - s.mean);
+        s.stddev = std::sqrt(sq / static_cast<double>(s.n - 1));
+    }
+
+    if (s.n == 1) {
+        s.ci_low = s.ci_high = s.median;
+        return s;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::vector<double> medians;
+    std::vector<double> scratch;
+    medians.reserve(kBootstrapResamples);
+    for (int i = 0; i < kBootstrapResamples; ++i) {
+        medians.push_back(detail::resample_median(samples, rng, scratch));
+    }
+    std::sort(medians.begin(), medians.end());
+    double alpha = (1.0 - kConfidence) / 2.0;
+    s.ci_low = percentile_sorted(medians, alpha);
+    s.ci_high = percentile_sorted(medians, 1.0 - alpha);
+    return s;
+}
+
+enum class Verdict {
+    insufficient,   // 样本不足
+    faster,         // a 显著快于 b
+    slower,         // a 显著慢于 b
+    indistinct,     // 无显著差异
+};
+
+struct Comparison {
+    double ratio = 0.0;     // median(a) / median(b)，< 1 表示 a 更快
+    double ci_low = 0.0;    // 中位数之比的 bootstrap 置信区间
+    double ci_high = 0.0;
+    Verdict verdict = Verdict::insufficient;
+};
+
+// 比较两组耗时样本：对中位数之比做 bootstrap，置信区间不含 1 即判为显著
+inline Comparison compare(const std::vector<double>& a, const std::vector<double>& b,
+                          uint64_t seed = 0xc0ffee) {
+    Comparison c;
+    if (a.empty() || b.empty()) return c;
+
+    double mb = median_of(b);
+    if (mb <= 0.0) return c;
+    c.ratio = median_of(a) / mb;
+    c.ci_low = c.ci_high = c.ratio;
+    if (a.size() < kMinSamplesForVerdict || b.size() < kMinSamplesForVerdict) {
+        return c;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::vector<double> ratios;
+    std::vector<double> scratch;
+    ratios.reserve(kBootstrapResamples);
+    for (int i = 0; i < kBootstrapResamples; ++i) {
+        double ra = detail::resample_median(a, rng, scratch);
+        double rb = detail::resample_median(b, rng, scratch);
+        if (rb > 0.0) ratios.push_back(ra / rb);
+    }
+    if (ratios.empty()) return c;
+    std::sort(ratios.begin(), ratios.end());
+    double alpha = (1.0 - kConfidence) / 2.0;
+    c.ci_low = percentile_sorted(ratios, alpha);
+    c.ci_high = percentile_sorted(ratios, 1.0 - alpha);
+
+    if (c.ci_high < 1.0) {
+        c.verdict = Verdict::faster;
+    } else if (c.ci_low > 1.0) {
+        c.verdict = Verdict::slower;
+    } else {
+        c.verdict = Verdict::indistinct;
+    }
+    return c;
+}
+
+inline const char* verdict_label(Verdict v) {
+    switch (v) {
+        case Verdict::faster: return "显著更快";
+        case Verdict::slower: return "显著更慢";
+        case Verdict::indistinct: return "无显著差异";
+        case Verdict::insufficient: break;
+    }
+    return "样本不足";
+}
+
+} // namespace bench
@@ -0,0 +1,597 @@
+#include <seastar/core/app-template.hh>
+#include <seastar/core/circular_buffer.hh>
+#include <seastar/core/coroutine.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/seastar.hh>
+#include <seastar/core/shared_future.hh>
+#include <seastar/core/sharded.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/sstring.hh>
+#include <seastar/core/when_all.hh>
+#include <seastar/util/file.hh>
+#include <seastar/util/log.hh>
+
+#include "chunk_manifest.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+static seastar::logger lg("joiner");
+
+/*
+ * settings shared by every shard. `sharded::start` copies them to each core.
+ */
+struct joiner_options {
+    size_t block_size;  // bytes per dma_write, a multiple of the page size
+    size_t write_ahead; // blocks kept in flight per shard
+};
+
+/*
+ * the CRC32C of the bytes [pos, pos + length) of a chunk, computed by the
+ * shard that copied them. the shards' segments of a chunk are combined into
+ * the chunk's checksum once every shard is done.
+ */
+struct chunk_segment {
+    size_t chunk;
+    uint64_t pos;
+    uint64_t length;
+    uint32_t crc;
+};
+
+/*
+ * the inverse of big_file_splitter: writes every chunk at its offset in the
+ * output. the output, not the chunk list, is divided between the shards in
+ * whole pages, so every dma_write is page aligned even when chunks are cut
+ * at arbitrary offsets (--split-on, --cdc) and a chunk may be assembled by
+ * two shards.
+ */
+class file_joiner final {
+    static constexpr size_t page_size = 4096;
+
+public:
+    file_joiner(
+      std::filesystem::path output,
+      std::vector<chunk_manifest::entry> chunks,
+      uint64_t size,
+      joiner_options opts)
+      : output_path_(std::move(output))
+      , chunks_(std::move(chunks))
+      , size_(size)
+      , opts_(opts) {
+    }
+
+    seastar::future<> start() {
+        output_ = co_await seastar::open_file_dma(
+          output_path_.string(), seastar::open_flags::wo);
+
+        const auto pages_per_core = (size_ / page_size) / seastar::smp::count;
+        start_ = pages_per_core * page_size * seastar::this_shard_id();
+        end_ = [&] {
+            if (seastar::this_shard_id() == (seastar::smp::count - 1)) {
+                return size_;
+            }
+            return start_ + pages_per_core * page_size;
+        }();
+
+        lg.info(
+          "Writing {} bytes from offset {} to {}", end_ - start_, start_, end_);
+
+        /*
+         * runs in the background under a gate, as in big_file_splitter, and
+         * counts as finished only once run() has resolved.
+         */
+        std::ignore = seastar::with_gate(gate_, [this] {
+            return run()
+              .handle_exception([this](std::exception_ptr ep) {
+                  lg.error("Joining failed: {}", ep);
+                  failed_ = true;
+              })
+              .finally([this] { finished_ = true; });
+        });
+    }
+
+    seastar::future<> stop() {
+        co_await gate_.close();
+        if (output_) {
+            co_await output_.close();
+        }
+    }
+
+    bool failed() const {
+        return failed_;
+    }
+
+    const std::vector<chunk_segment>& segments() const {
+        return segments_;
+    }
+
+    double progress() const {
+        if (finished_ || failed_) {
+            return 100.0;
+        }
+        auto total = end_ - start_;
+        if (total == 0) {
+            return 0.0;
+        }
+        return std::min(99.9, (static_cast<double>(done_) / total) * 100.0);
+    }
+
+private:
+    using buffer = seastar::temporary_buffer<char>;
+
+    /*
+     * keep write_ahead blocks in flight and retire them in output order, so
+     * the chunks a retired block read from can be closed once no later block
+     * can need them.
+     */
+    seastar::future<> run() {
+        seastar::circular_buffer<seastar::future<>> blocks;
+        uint64_t next_block = start_;
+        uint64_t retired = start_;
+        std::exception_ptr error;
+        try {
+            while (true) {
+                while (blocks.size() < opts_.write_ahead && next_block < end_) {
+                    const auto len = std::min<uint64_t>(
+                      opts_.block_size, end_ - next_block);
+                    blocks.push_back(join_block(next_block, len));
+                    next_block += len;
+                }
+                if (blocks.empty()) {
+                    break;
+                }
+                co_await std::move(blocks.front());
+                blocks.pop_front();
+                retired = std::min<uint64_t>(retired + opts_.block_size, end_);
+                co_await close_chunks_before(retired);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        for (auto& block : blocks) {
+            co_await std::move(block).then_wrapped(
+              [](auto f) { f.ignore_ready_future(); });
+        }
+        co_await close_chunks_before(std::numeric_limits<uint64_t>::max());
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /*
+     * fill a page-aligned buffer with the output bytes [offset, offset + len)
+     * from the chunks covering them, reading all of them concurrently, and
+     * write it in one request. the final partial page is zero padded here and
+     * truncated away once every shard is done. each chunk segment is
+     * checksummed while it is in the buffer.
+     */
+    seastar::future<> join_block(uint64_t offset, size_t len) {
+        const auto padded = align_up(len);
+        auto buf = buffer::aligned(page_size, padded);
+        std::memset(buf.get_write() + len, 0, padded - len);
+
+        std::vector<seastar::future<>> reads;
+        std::vector<chunk_segment> segments;
+        const auto end = offset + len;
+        for (auto chunk = first_chunk_ending_after(offset);
+             chunk < chunks_.size() && chunks_[chunk].offset < end;
+             ++chunk) {
+            const auto& entry = chunks_[chunk];
+            const auto from = std::max(offset, entry.offset);
+            const auto to = std::min(end, entry.offset + entry.length);
+            if (from < to) {
+                segments.push_back(chunk_segment{
+                  .chunk = chunk, .pos = from - entry.offset, .length = to - from});
+                reads.push_back(read_segment(
+                  chunk,
+                  from - entry.offset,
+                  buf.get_write() + (from - offset),
+                  to - from));
+            }
+        }
+        co_await seastar::when_all_succeed(reads.begin(), reads.end())
+          .discard_result();
+
+        for (auto& segment : segments) {
+            const auto from = chunks_[segment.chunk].offset + segment.pos;
+            segment.crc = chunk_manifest::crc32c(
+              0, buf.get() + (from - offset), segment.length);
+            segments_.push_back(segment);
+        }
+
+        const auto written = co_await output_.dma_write(
+          offset, buf.get(), padded);
+        if (written != padded) {
+            throw std::runtime_error(fmt::format(
+              "Short write with size {} != {} occurred at offset {}",
+              written,
+              padded,
+              offset));
+        }
+        done_ += len;
+    }
+
+    /*
+     * copy len bytes at pos in the chunk to dest. page-aligned spans are read
+     * straight into the block buffer; the rest, around unaligned cuts, goes
+     * through a dma_read_bulk buffer and a copy.
+     */
+    seastar::future<>
+    read_segment(size_t chunk, uint64_t pos, char* dest, size_t len) {
+        auto file = co_await chunk_file(chunk);
+        const auto aligned = pos % page_size == 0 && len % page_size == 0
+                             && reinterpret_cast<uintptr_t>(dest) % page_size
+                                  == 0;
+        size_t n = 0;
+        if (aligned) {
+            n = co_await file.dma_read(pos, dest, len);
+        } else {
+            const auto data = co_await file.dma_read_bulk<char>(pos, len);
+            n = data.size();
+            std::memcpy(dest, data.get(), std::min(n, len));
+        }
+        if (n != len) {
+            throw std::runtime_error(fmt::format(
+              "Short read with size {} != {} occurred at offset {} of {}",
+              n,
+              len,
+              pos,
+              chunks_[chunk].name));
+        }
+    }
+
+    /*
+     * chunks are opened on first use, once per shard even when several
+     * blocks read from them at the same time.
+     */
+    seastar::future<seastar::file> chunk_file(size_t chunk) {
+        auto it = open_.find(chunk);
+        if (it == open_.end()) {
+            it = open_.emplace(chunk, open_chunk(chunk)).first;
+        }
+        return it->second.get_future();
+    }
+
+    seastar::future<seastar::file> open_chunk(size_t chunk) {
+        const auto& entry = chunks_[chunk];
+        auto file = co_await seastar::open_file_dma(
+          entry.name, seastar::open_flags::ro);
+        const auto size = co_await file.size();
+        if (size != entry.length) {
+            co_await file.close();
+            throw std::runtime_error(fmt::format(
+              "{} has {} bytes, expected {}", entry.name, size, entry.length));
+        }
+        co_return file;
+    }
+
+    seastar::future<> close_chunks_before(uint64_t offset) {
+        while (!open_.empty()) {
+            const auto it = open_.begin();
+            const auto& entry = chunks_[it->first];
+            if (entry.offset + entry.length > offset) {
+                break;
+            }
+            auto file = std::move(it->second);
+            open_.erase(it);
+            try {
+                co_await (co_await file.get_future()).close();
+            } catch (...) {
+                /*
+                 * the open failed, which the block that needed it reported.
+                 */
+            }
+        }
+    }
+
+    size_t first_chunk_ending_after(uint64_t offset) const {
+        return std::upper_bound(
+                 chunks_.begin(),
+                 chunks_.end(),
+                 offset,
+                 [](uint64_t offset, const chunk_manifest::entry& entry) {
+                     return offset < entry.offset + entry.length;
+                 })
+               - chunks_.begin();
+    }
+
+    static uint64_t align_up(uint64_t n) {
+        return (n + page_size - 1) / page_size * page_size;
+    }
+
+    std::filesystem::path output_path_;
+    std::vector<chunk_manifest::entry> chunks_; // in output order, tiling it
+    uint64_t size_;
+    joiner_options opts_;
+    seastar::gate gate_;
+    seastar::file output_;
+    std::map<size_t, seastar::shared_future<seastar::file>> open_;
+    std::vector<chunk_segment> segments_;
+    uint64_t start_{0};
+    uint64_t end_{0};
+    uint64_t done_{0}; // bytes written so far
+    bool failed_{false};
+    bool finished_{false}; // run() has resolved, successfully or not
+};
+
+/*
+ * the chunks listed in a big_file_splitter manifest, with their names
+ * resolved against the manifest's directory.
+ */
+static seastar::future<std::vector<chunk_manifest::entry>>
+read_manifest(std::filesystem::path path) {
+    const auto text = co_await seastar::util::read_entire_file_contiguous(path);
+
+    std::vector<chunk_manifest::entry> chunks;
+    std::string_view rest(text.data(), text.size());
+    for (size_t line_no = 1; !rest.empty(); ++line_no) {
+        const auto newline = rest.find('\n');
+        const auto line = rest.substr(0, newline);
+        rest = newline == std::string_view::npos ? std::string_view{}
+                                                  : rest.substr(newline + 1);
+        bool malformed = false;
+        auto entry = chunk_manifest::parse_line(line, malformed);
+        if (malformed) {
+            throw std::runtime_error(
+              fmt::format("{}:{}: malformed manifest line", path.string(), line_no));
+        }
+        if (entry) {
+            entry->name = (path.parent_path() / entry->name).string();
+            chunks.push_back(std::move(*entry));
+        }
+    }
+    co_return chunks;
+}
+
+/*
+ * chunk files given on the command line, concatenated in that order.
+ */
+static seastar::future<std::vector<chunk_manifest::entry>>
+stat_chunks(std::vector<std::string> names) {
+    std::vector<chunk_manifest::entry> chunks;
+    uint64_t offset = 0;
+    for (auto& name : names) {
+        const auto length = co_await seastar::file_size(name);
+        chunks.push_back(chunk_manifest::entry{
+          .name = std::move(name), .offset = offset, .length = length});
+        offset += length;
+    }
+    co_return chunks;
+}
+
+/*
+ * every chunk a manifest lists must exist with its listed length, including
+ * empty ones, which no block ever reads.
+ */
+static seastar::future<bool>
+check_chunk_files(const std::vector<chunk_manifest::entry>& chunks) {
+    bool ok = true;
+    for (const auto& chunk : chunks) {
+        try {
+            const auto size = co_await seastar::file_size(chunk.name);
+            if (size != chunk.length) {
+                lg.error(
+                  "{} has {} bytes, expected {}", chunk.name, size, chunk.length);
+                ok = false;
+            }
+        } catch (...) {
+            lg.error("Cannot stat {}: {}", chunk.name, std::current_exception());
+            ok = false;
+        }
+    }
+    co_return ok;
+}
+
+/*
+ * combine the shards' segment checksums into one per chunk and compare them
+ * with the manifest. chunks without a checksum (--zero-copy) are skipped.
+ */
+static bool check_chunk_crcs(
+  const std::vector<chunk_manifest::entry>& chunks,
+  std::vector<chunk_segment> segments) {
+    std::sort(segments.begin(), segments.end(), [](const auto& a, const auto& b) {
+        return std::tie(a.chunk, a.pos) < std::tie(b.chunk, b.pos);
+    });
+
+    std::vector<uint32_t> crcs(chunks.size(), 0);
+    std::vector<uint64_t> covered(chunks.size(), 0);
+    for (const auto& segment : segments) {
+        if (segment.pos != covered[segment.chunk]) {
+            lg.error(
+              "{}: bytes {} to {} were not joined",
+              chunks[segment.chunk].name,
+              covered[segment.chunk],
+              segment.pos);
+            return false;
+        }
+        crcs[segment.chunk] = chunk_manifest::crc32c_combine(
+          crcs[segment.chunk], segment.crc, segment.length);
+        covered[segment.chunk] += segment.length;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (!chunks[i].crc) {
+            continue;
+        }
+        if (covered[i] != chunks[i].length || crcs[i] != *chunks[i].crc) {
+            lg.error(
+              "{}: checksum {:08x}, expected {:08x}",
+              chunks[i].name,
+              crcs[i],
+              *chunks[i].crc);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static seastar::future<> monitor(seastar::sharded<file_joiner>& joiner) {
+    while (true) {
+        const auto progress = co_await joiner.map(
+          [](file_joiner& joiner) { return joiner.progress(); });
+
+        lg.info("Progress: {:.1f}", fmt::join(progress, " "));
+
+        const auto all_done = std::all_of(
+          progress.begin(), progress.end(), [](auto p) { return p == 100.0; });
+        if (all_done) {
+            break;
+        }
+
+        co_await seastar::sleep(std::chrono::seconds(1));
+    }
+}
+
+/*
+ * create or empty the output before the shards open it, and afterwards cut
+ * the zero padding of the final page.
+ */
+static seastar::future<> resize_output(std::string path, uint64_t size) {
+    auto file = co_await seastar::open_file_dma(
+      path, seastar::open_flags::create | seastar::open_flags::wo);
+    std::exception_ptr error;
+    try {
+        co_await file.truncate(size);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    co_await file.close();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+static seastar::future<int> join(
+  seastar::sharded<file_joiner>& joiner,
+  std::string output,
+  std::string manifest,
+  std::vector<std::string> names,
+  joiner_options opts) {
+    const auto chunks = manifest.empty()
+                          ? co_await stat_chunks(std::move(names))
+                          : co_await read_manifest(manifest);
+
+    /*
+     * the chunks must tile the output without gaps or overlaps.
+     */
+    uint64_t size = 0;
+    for (const auto& chunk : chunks) {
+        if (chunk.offset != size) {
+            lg.error(
+              "{} starts at offset {}, expected {}",
+              chunk.name,
+              chunk.offset,
+              size);
+            co_return 1;
+        }
+        size += chunk.length;
+    }
+    if (!co_await check_chunk_files(chunks)) {
+        co_return 1;
+    }
+    lg.info("Joining {} chunks, {} bytes, into {}", chunks.size(), size, output);
+
+    co_await resize_output(output, 0);
+    co_await joiner.start(output, chunks, size, opts);
+    co_await joiner.invoke_on_all(&file_joiner::start);
+    co_await monitor(joiner);
+
+    const auto failed = co_await joiner.map(
+      [](file_joiner& joiner) { return joiner.failed(); });
+    if (std::any_of(failed.begin(), failed.end(), [](bool f) { return f; })) {
+        co_return 1;
+    }
+
+    auto segments = co_await joiner.map(
+      [](file_joiner& joiner) { return joiner.segments(); });
+    std::vector<chunk_segment> all;
+    for (auto& shard : segments) {
+        all.insert(all.end(), shard.begin(), shard.end());
+    }
+    if (!check_chunk_crcs(chunks, std::move(all))) {
+        co_return 1;
+    }
+    co_await resize_output(output, size);
+    co_return 0;
+}
+
+int main(int argc, char** argv) {
+    seastar::sharded<file_joiner> joiner;
+
+    seastar::app_template app;
+    {
+        namespace po = boost::program_options;
+
+        /*
+         * --output <file> to reassemble into.
+         */
+        app.add_options()(
+          "output", po::value<seastar::sstring>()->required(), "output file");
+
+        /*
+         * --manifest <file> written by big_file_splitter, or the chunk files
+         *  themselves as --chunk <file>..., joined in the order given.
+         */
+        app.add_options()(
+          "manifest", po::value<std::string>(), "chunk manifest file");
+        app.add_options()(
+          "chunk",
+          po::value<std::vector<std::string>>()->multitoken(),
+          "chunk files in output order");
+
+        /*
+         * --write-size <KiB> is the size of each dma_write and --write-ahead
+         *  <n> the number of them kept in flight per shard, each filled by
+         *  concurrent reads from the chunks it covers.
+         */
+        app.add_options()(
+          "write-size",
+          po::value<size_t>()->default_value(1024),
+          "size of each write in KiB (multiple of 4)");
+        app.add_options()(
+          "write-ahead",
+          po::value<size_t>()->default_value(4),
+          "writes kept in flight per shard");
+    }
+
+    return app.run(argc, argv, [&] {
+        auto& opts = app.configuration();
+        const auto output = opts["output"].as<seastar::sstring>();
+        const auto manifest = opts.count("manifest")
+                                ? opts["manifest"].as<std::string>()
+                                : std::string();
+        auto names = opts.count("chunk")
+                       ? opts["chunk"].as<std::vector<std::string>>()
+                       : std::vector<std::string>();
+        if (manifest.empty() == names.empty()) {
+            lg.error("give either --manifest or --chunk");
+            return seastar::make_ready_future<int>(1);
+        }
+        const joiner_options options{
+          .block_size = opts["write-size"].as<size_t>() * 1024,
+          .write_ahead = opts["write-ahead"].as<size_t>(),
+        };
+        if (options.block_size == 0 || options.block_size % 4096 != 0
+            || options.write_ahead == 0) {
+            lg.error(
+              "--write-size must be a positive multiple of 4 KiB and "
+              "--write-ahead at least 1");
+            return seastar::make_ready_future<int>(1);
+        }
+
+        seastar::engine().at_exit([&joiner] { return joiner.stop(); });
+
+        return join(joiner, output, manifest, std::move(names), options);
+    });
+}
@@ -1,72 +1,518 @@
 #include <seastar/core/app-template.hh>
+#include <seastar/core/chunked_fifo.hh>
+#include <seastar/core/circular_buffer.hh>
 #include <seastar/core/coroutine.hh>
 #include <seastar/core/fstream.hh>
+#include <seastar/core/queue.hh>
+#include <seastar/core/scheduling.hh>
 #include <seastar/core/reactor.hh>
+#include <seastar/core/semaphore.hh>
 #include <seastar/core/sharded.hh>
 #include <seastar/core/sleep.hh>
 #include <seastar/core/sstring.hh>
+#include <seastar/core/when_all.hh>
+#include <seastar/core/with_scheduling_group.hh>
+#include <seastar/coroutine/maybe_yield.hh>
 #include <seastar/util/log.hh>
 
+#include "chunk_manifest.hpp"
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
 #include <chrono>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
 static seastar::logger lg("splitter");
 
+/*
+ * owns a raw file descriptor, for the syscalls seastar::file does not wrap.
+ */
+class file_descriptor {
+public:
+    explicit file_descriptor(int fd)
+      : fd_(fd) {
+    }
+    file_descriptor(const file_descriptor&) = delete;
+    file_descriptor& operator=(const file_descriptor&) = delete;
+    ~file_descriptor() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    int get() const {
+        return fd_;
+    }
+    explicit operator bool() const {
+        return fd_ >= 0;
+    }
+
+private:
+    int fd_;
+};
+
+/*
+ * where shard and chunk boundaries may fall (--split-on): anywhere, after a
+ * newline, or on a multiple of a fixed record size.
+ */
+struct split_rule {
+    enum class kind { none, newline, record };
+    kind type = kind::none;
+    uint64_t record_size = 0;
+};
+
+static std::optional<split_rule> parse_split_rule(std::string_view text) {
+    if (text == "none") {
+        return split_rule{};
+    }
+    if (text == "newline") {
+        return split_rule{.type = split_rule::kind::newline};
+    }
+    constexpr std::string_view record = "record:";
+    if (text.starts_with(record)) {
+        uint64_t size = 0;
+        const auto digits = text.substr(record.size());
+        const auto [end, ec] = std::from_chars(
+          digits.data(), digits.data() + digits.size(), size);
+        if (ec == std::errc() && end == digits.data() + digits.size()
+            && size > 0) {
+            return split_rule{
+              .type = split_rule::kind::record, .record_size = size};
+        }
+    }
+    return std::nullopt;
+}
+
+/*
+ * a byte count with an optional binary K, M, G or T suffix, e.g. 64M.
+ */
+static std::optional<uint64_t> parse_size(std::string_view text) {
+    uint64_t size = 0;
+    const auto [end, ec] = std::from_chars(
+      text.data(), text.data() + text.size(), size);
+    if (ec != std::errc() || end == text.data()) {
+        return std::nullopt;
+    }
+    const auto suffix = text.substr(end - text.data());
+    if (suffix.empty()) {
+        return size;
+    }
+    if (suffix.size() != 1) {
+        return std::nullopt;
+    }
+    constexpr std::string_view units = "KMGT";
+    const auto unit = units.find(static_cast<char>(std::toupper(suffix[0])));
+    if (unit == std::string_view::npos) {
+        return std::nullopt;
+    }
+    const auto shift = 10 * (unit + 1);
+    if (size > (std::numeric_limits<uint64_t>::max() >> shift)) {
+        return std::nullopt;
+    }
+    return size << shift;
+}
+
+/*
+ * content-defined chunking (--cdc): chunk sizes fall between min_size and
+ * max_size and average about avg_size.
+ */
+struct cdc_params {
+    uint64_t min_size = 0;
+    uint64_t avg_size = 0;
+    uint64_t max_size = 0;
+
+    explicit operator bool() const {
+        return avg_size != 0;
+    }
+};
+
+/*
+ * either <avg>, with the FastCDC defaults min = avg / 4 and max = avg * 8,
+ * or <min>:<avg>:<max>. sizes take the suffixes of parse_size().
+ */
+static std::optional<cdc_params> parse_cdc(std::string_view text) {
+    cdc_params params;
+    if (const auto colon = text.find(':'); colon == std::string_view::npos) {
+        const auto avg = parse_size(text);
+        if (!avg || *avg > (std::numeric_limits<uint64_t>::max() >> 3)) {
+            return std::nullopt;
+        }
+        params = {
+          .min_size = *avg / 4, .avg_size = *avg, .max_size = *avg * 8};
+    } else {
+        const auto rest = text.substr(colon + 1);
+        const auto colon2 = rest.find(':');
+        if (colon2 == std::string_view::npos) {
+            return std::nullopt;
+        }
+        const auto min = parse_size(text.substr(0, colon));
+        const auto avg = parse_size(rest.substr(0, colon2));
+        const auto max = parse_size(rest.substr(colon2 + 1));
+        if (!min || !avg || !max) {
+            return std::nullopt;
+        }
+        params = {.min_size = *min, .avg_size = *avg, .max_size = *max};
+    }
+
+    /*
+     * the hash masks take log2(avg) +- 2 bits of a 64-bit hash.
+     */
+    if (params.avg_size < 64 || params.avg_size > (uint64_t(1) << 62)
+        || params.min_size > params.avg_size
+        || params.avg_size > params.max_size) {
+        return std::nullopt;
+    }
+    return params;
+}
+
+/*
+ * the Gear hash's per-byte values: a fixed table (splitmix64 from a fixed
+ * seed), so cuts are reproducible across runs and builds.
+ */
+static constexpr std::array<uint64_t, 256> make_gear_table() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x6765617243444321;
+    for (auto& value : table) {
+        state += 0x9e3779b97f4a7c15;
+        auto z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}
+
+/*
+ * FastCDC over a Gear rolling hash. every byte shifts the hash left and adds
+ * a random value for the byte, so a bit of the hash depends only on the last
+ * 64 bytes and a cut found after an insertion earlier in the input is found
+ * again at the same content. a cut falls where the masked top bits of the
+ * hash are zero. the first min_size bytes of a chunk are skipped unhashed,
+ * and normalized chunking uses a stricter mask before avg_size and a looser
+ * one after it, which narrows the size distribution; max_size forces a cut.
+ *
+ * the chunker is a pure function of the data from its current chunk start,
+ * so two chunkers that once cut at the same offset agree from then on.
+ */
+class gear_chunker {
+public:
+    gear_chunker(cdc_params params, uint64_t start)
+      : params_(params)
+      , small_mask_(top_bits(std::bit_width(params.avg_size) + 1))
+      , large_mask_(top_bits(std::bit_width(params.avg_size) - 3))
+      , last_(start) {
+    }
+
+    /*
+     * hash the len bytes at offset, which continue the bytes fed so far, and
+     * append the cuts found among them.
+     */
+    void feed(
+      const char* data,
+      size_t len,
+      uint64_t offset,
+      std::vector<uint64_t>& cuts) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+        size_t i = 0;
+        while (i < len) {
+            const auto filled = offset + i - last_;
+            if (filled < params_.min_size) {
+                i += std::min<uint64_t>(len - i, params_.min_size - filled);
+                continue;
+            }
+
+            /*
+             * hash up to the next size threshold with a fixed mask, so the
+             * inner loop is a shift, a table load, an add and a test per byte.
+             */
+            const auto small = filled < params_.avg_size;
+            const auto mask = small ? small_mask_ : large_mask_;
+            const auto stop = i
+                              + std::min<uint64_t>(
+                                len - i,
+                                (small ? params_.avg_size : params_.max_size)
+                                  - filled);
+            auto hash = hash_;
+            bool found = false;
+            while (i < stop) {
+                hash = (hash << 1) + gear[bytes[i++]];
+                if ((hash & mask) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+            hash_ = hash;
+            if (found || offset + i - last_ == params_.max_size) {
+                last_ = offset + i;
+                hash_ = 0;
+                cuts.push_back(last_);
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t top_bits(unsigned n) {
+        return ~uint64_t(0) << (64 - n);
+    }
+
+    static constexpr std::array<uint64_t, 256> gear = make_gear_table();
+
+    cdc_params params_;
+    uint64_t small_mask_; // log2(avg) + 2 bits, before avg_size
+    uint64_t large_mask_; // log2(avg) - 2 bits, from avg_size on
+    uint64_t last_;       // offset of the current chunk's start
+    uint64_t hash_{0};
+};
+
+/*
+ * paces a stream of I/O to a byte rate (--max-read-mbps, --max-write-mbps).
+ * every request reserves the next slot of len / rate seconds and sleeps until
+ * its slot starts, so requests issued back to back, or concurrently, are
+ * spread out evenly. a rate of 0 never waits.
+ */
+class rate_limiter {
+    using clock = seastar::steady_clock_type;
+
+public:
+    explicit rate_limiter(uint64_t bytes_per_sec)
+      : rate_(bytes_per_sec) {
+    }
+
+    seastar::future<> consume(uint64_t len) {
+        if (rate_ == 0) {
+            return seastar::make_ready_future<>();
+        }
+        const auto now = clock::now();
+        const auto slot = std::max(next_, now);
+        next_ = slot
+                + std::chrono::duration_cast<clock::duration>(
+                  std::chrono::duration<double>(
+                    static_cast<double>(len) / rate_));
+        if (slot <= now) {
+            return seastar::make_ready_future<>();
+        }
+        return seastar::sleep(slot - now);
+    }
+
+private:
+    uint64_t rate_;
+    clock::time_point next_{};
+};
+
+/*
+ * settings shared by every shard. `sharded::start` copies them to each core.
+ */
+struct splitter_options {
+    double memory_pct;
+    size_t read_size;  // bytes per dma_read_bulk, a multiple of the page size
+    size_t read_ahead; // reads kept in flight ahead of the consumer
+    bool pipeline;     // overlap reading and writing, see run_pipelined()
+    bool zero_copy;    // reflink / copy_file_range, see run_zero_copy()
+    split_rule split_on;
+    uint64_t chunk_size; // --chunk-size, 0 if not given
+    uint64_t chunks;     // --chunks, 0 if not given
+    cdc_params cdc;      // --cdc, see plan_content_defined()
+
+    /*
+     * reads and writes run in their own scheduling groups, which carry the
+     * I/O priority of the requests they issue, and are paced to these
+     * rates, in bytes per second, each shard to an equal share of them
+     * (see file_splitter::shard_rate()). 0 means unlimited.
+     */
+    seastar::scheduling_group read_group;
+    seastar::scheduling_group write_group;
+    uint64_t max_read_rate;
+    uint64_t max_write_rate;
+};
+
 class file_splitter final {
     static constexpr size_t page_size = 4096;
 
 public:
-    file_splitter(std::filesystem::path path, double memory_pct)
+    file_splitter(std::filesystem::path path, splitter_options opts)
       : path_(std::move(path))
-      , memory_pct_(memory_pct) {
+      , opts_(opts)
+      , read_limit_(shard_rate(opts.max_read_rate))
+      , write_limit_(shard_rate(opts.max_write_rate)) {
     }
 
-    seastar::future<> start() {
+    seastar::future<> open() {
         file_ = co_await seastar::open_file_dma(
           path_.string(), seastar::open_flags::ro);
 
-        const auto size = co_await file_.size();
+        size_ = co_await file_.size();
+        budget_ = std::max<size_t>(
+                    1,
+                    static_cast<size_t>(
+                      (seastar::memory::stats().total_memory()
+                       * opts_.memory_pct)
+                      / page_size))
+                  * page_size;
+    }
 
-        /*
-         * limit input size to be a multiple of page size for simpler math.
-         */
-        if (size % page_size != 0) {
-            throw std::runtime_error(fmt::format(
-              "Input file size {} must be a multiple of page size {}",
-              size,
-              page_size));
+    /*
+     * lay out this shard's chunks, except with --cdc where the shards plan
+     * together (see plan_content_defined()).
+     */
+    seastar::future<> plan() {
+        if (explicit_layout()) {
+            co_await plan_explicit();
+        } else {
+            co_await plan_per_shard();
+        }
+    }
+
+    /*
+     * first --cdc phase: chunk this shard's nominal range as if a chunk
+     * started at its first byte, and return the cuts, led by that start.
+     */
+    seastar::future<std::vector<uint64_t>> scan_content_defined() {
+        nominal_range();
+        chunker_.emplace(opts_.cdc, start_);
+        cuts_ = {start_};
+
+        const uint64_t end = end_;
+        uint64_t next_read = start_;
+        uint64_t pos = start_;
+        read_queue reads;
+        std::exception_ptr error;
+        try {
+            while (true) {
+                while (reads.size() < opts_.read_ahead && next_read < end) {
+                    const auto len = std::min<uint64_t>(
+                      opts_.read_size, end - next_read);
+                    reads.push_back(read_at(next_read, len));
+                    next_read += len;
+                }
+                if (reads.empty()) {
+                    break;
+                }
+                const auto buf = co_await std::move(reads.front());
+                reads.pop_front();
+                chunker_->feed(buf.get(), buf.size(), pos, cuts_);
+                pos += buf.size();
+                co_await seastar::coroutine::maybe_yield();
+            }
+        } catch (...) {
+            error = std::current_exception();
         }
 
-        const auto total_pages = size / page_size;
-        const auto pages_per_core = total_pages / seastar::smp::count;
-        start_page_ = pages_per_core * seastar::this_shard_id();
+        co_await drain(reads);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        co_return cuts_;
+    }
 
-        /*
-         * the end page for the core with the largest id is adjusted to
-         * account for an uneven division of pages among cores.
-         */
-        end_page_ = [&] {
-            if (seastar::this_shard_id() == (seastar::smp::count - 1)) {
-                return total_pages - 1;
+    /*
+     * second --cdc phase: carry this shard's chain of cuts past its range
+     * until it reaches a cut of the shard whose range it has entered. from
+     * there both chains are identical, so that cut, returned here, is where
+     * this shard's chunks end and the other shard's begin. a chain that
+     * reaches the end of the input ends there.
+     */
+    seastar::future<uint64_t>
+    extend_content_defined(const std::vector<std::vector<uint64_t>>& scans) {
+        auto synced = [&](uint64_t cut) {
+            if (cut >= size_) {
+                return true;
             }
-            return start_page_ + pages_per_core - 1;
-        }();
+            const auto owner = std::prev(std::upper_bound(
+              scans.begin(),
+              scans.end(),
+              cut,
+              [](uint64_t c, const auto& scan) { return c < scan.front(); }));
+            return std::binary_search(owner->begin(), owner->end(), cut);
+        };
 
+        if (cuts_.back() >= end_ && synced(cuts_.back())) {
+            co_return cuts_.back();
+        }
+        for (uint64_t pos = end_; pos < size_;) {
+            const auto len = std::min<uint64_t>(opts_.read_size, size_ - pos);
+            const auto buf = co_await read_at(pos, len);
+            const auto found = cuts_.size();
+            chunker_->feed(buf.get(), len, pos, cuts_);
+            for (auto i = found; i < cuts_.size(); ++i) {
+                if (synced(cuts_[i])) {
+                    cuts_.resize(i + 1);
+                    co_return cuts_.back();
+                }
+            }
+            pos += len;
+        }
+        cuts_.push_back(size_);
+        co_return size_;
+    }
+
+    /*
+     * last --cdc phase: keep the part of the chain in [begin, end] and
+     * return the number of chunks it makes.
+     */
+    size_t assign_content_defined(uint64_t begin, uint64_t end) {
+        std::vector<uint64_t> cuts{begin};
+        for (const auto cut : cuts_) {
+            if (cut > begin && cut <= end) {
+                cuts.push_back(cut);
+            }
+        }
+        cuts_ = std::move(cuts);
+        start_ = begin;
+        end_ = end;
+        chunker_.reset();
+        return cuts_.size() - 1;
+    }
+
+    void number_chunks(uint64_t first_chunk, size_t name_width) {
+        first_chunk_ = first_chunk;
+        name_width_ = name_width;
+    }
+
+    seastar::future<> start() {
         lg.info(
-          "Processing {} pages with index {} to {}",
-          end_page_ - start_page_ + 1,
-          start_page_,
-          end_page_);
+          "Processing {} bytes from offset {} to {} in {} chunks",
+          end_ - start_,
+          start_,
+          end_,
+          cuts_.size() - 1);
 
         /*
          * invokes `run()` in the background. in order to be able to synchronize
          * with the background fiber running it is started under a `gate` which
          * can be used to wait until the background fiber finishes, which is
-         * done in `stop()`.
+         * done in `stop()`. a failure is logged and recorded so that the
+         * monitor does not wait for progress that will never be made. the
+         * shard only counts as finished once run() has resolved: the last
+         * bytes are counted before their chunk is flushed, closed and
+         * recorded, and empty chunks come after them.
          */
-        std::ignore = seastar::with_gate(gate_, [this] { return run(); });
+        std::ignore = seastar::with_gate(gate_, [this] {
+            return run()
+              .handle_exception([this](std::exception_ptr ep) {
+                  lg.error("Splitting failed: {}", ep);
+                  failed_ = true;
+              })
+              .finally([this] { finished_ = true; });
+        });
+        return seastar::make_ready_future<>();
     }
 
     seastar::future<> stop() {
@@ -74,106 +520,775 @@ public:
         co_await file_.close();
     }
 
+    bool failed() const {
+        return failed_;
+    }
+
+    /*
+     * this shard's chunks in input order, once run() has finished.
+     */
+    std::vector<chunk_manifest::entry> manifest() const {
+        return manifest_;
+    }
+
+    /*
+     * 100 only once run() has resolved; until then the byte count is capped
+     * just below it.
+     */
     double progress() const {
-        if (gate_.is_closed()) {
+        if (finished_ || failed_) {
             return 100.0;
         }
-        auto total = end_page_ - start_page_;
+        auto total = end_ - start_;
         if (total == 0) {
-            return 100.0;
+            return 0.0;
         }
-        return (static_cast<double>(curr_page_ - start_page_) / total) * 100.0;
+        return std::min(99.9, (static_cast<double>(done_) / total) * 100.0);
     }
 
 private:
-    seastar::future<> run() {
-        const auto pages_memory_limit = static_cast<size_t>(
-          (seastar::memory::stats().total_memory() * memory_pct_) / page_size);
+    using buffer = seastar::temporary_buffer<char>;
+    using read_queue = seastar::circular_buffer<seastar::future<buffer>>;
+    using chunk_stream = std::optional<seastar::output_stream<char>>;
+
+    /*
+     * a cap is split evenly and statically between the shards, so bandwidth
+     * a shard leaves unused, e.g. once its range is done, is not passed on.
+     * a non-zero cap never rounds down to 0, which would mean unlimited.
+     */
+    static uint64_t shard_rate(uint64_t rate) {
+        if (rate == 0) {
+            return 0;
+        }
+        return std::max<uint64_t>(1, rate / seastar::smp::count);
+    }
+
+    bool explicit_layout() const {
+        return opts_.chunk_size != 0 || opts_.chunks != 0;
+    }
+
+    /*
+     * default layout: the chunk size is the --memory-pct buffer, so every
+     * chunk is read into memory whole before it is written.
+     */
+    seastar::future<> plan_per_shard() {
+        nominal_range();
 
         /*
-         * read up to pages_memory_limit pages worth of data and then write the
-         * data to a new chunk file. repeat until all pages have been processed.
+         * with --split-on both ends move forward to the next record boundary.
+         * neighbouring shards derive their shared boundary from the same
+         * nominal offset, so the ranges still tile the input.
          */
-        size_t chunk = 0;
-        seastar::chunked_fifo<seastar::temporary_buffer<char>> pages;
-        for (curr_page_ = start_page_; curr_page_ <= end_page_; ++curr_page_) {
-            /*
-             * allocate a page and read it from the file. the dma-family of I/O
-             * interfaces require aligned memory, size, and file offsets.
-             */
-            auto buf = seastar::temporary_buffer<char>::aligned(
-              page_size, page_size);
+        start_ = co_await next_boundary(start_);
+        end_ = co_await next_boundary(end_);
+        cuts_ = co_await plan_chunks(budget_);
+    }
 
-            const auto size = co_await file_.dma_read(
-              curr_page_ * page_size, buf.get_write(), page_size);
+    /*
+     * every shard gets the same number of whole pages, so its range starts
+     * page aligned and the bulk of the reads qualify for O_DIRECT. the core
+     * with the largest id also takes the remainder of an uneven division,
+     * including a final partial page.
+     */
+    void nominal_range() {
+        const auto pages_per_core = (size_ / page_size) / seastar::smp::count;
+        start_ = pages_per_core * page_size * seastar::this_shard_id();
+        end_ = [&] {
+            if (seastar::this_shard_id() == (seastar::smp::count - 1)) {
+                return size_;
+            }
+            return start_ + pages_per_core * page_size;
+        }();
+    }
 
-            /*
-             * check for a short read. we don't handle it, but retrying or
-             * reading the remainder would be reasonable. see also
-             * seastar::file::dma_read_bulk.
-             */
-            if (size != page_size) {
-                throw std::runtime_error(fmt::format(
-                  "Short read with size {} != {} occurred at offset {}",
-                  size,
-                  page_size,
-                  curr_page_ * page_size));
+    /*
+     * explicit layout (--chunk-size / --chunks): chunk i nominally starts at
+     * nominal_offset(i), moved to the next record boundary like every other
+     * cut, and ends where chunk i + 1 starts. chunks are numbered across the
+     * whole input and each shard takes a contiguous run of them, so the
+     * layout depends only on the input and the options, not on -c or the
+     * memory size, which then only bounds how much data is buffered.
+     */
+    seastar::future<> plan_explicit() {
+        const uint64_t chunks = opts_.chunks != 0
+                                  ? opts_.chunks
+                                  : (size_ + opts_.chunk_size - 1)
+                                      / opts_.chunk_size;
+        const auto shard = seastar::this_shard_id();
+        first_chunk_ = chunks * shard / seastar::smp::count;
+        const auto last_chunk = chunks * (shard + 1) / seastar::smp::count;
+        name_width_ = std::to_string(chunks > 0 ? chunks - 1 : 0).size();
+
+        cuts_.clear();
+        for (auto i = first_chunk_; i <= last_chunk; ++i) {
+            cuts_.push_back(co_await next_boundary(nominal_offset(i, chunks)));
+        }
+        start_ = cuts_.front();
+        end_ = cuts_.back();
+    }
+
+    /*
+     * --chunk-size cuts every chunk_size bytes. --chunks spreads the input
+     * over exactly that many chunks, rounding the cuts down to a page so
+     * they stay aligned; sizes then differ by less than a page, and an input
+     * smaller than a page per chunk leaves some of them empty.
+     */
+    uint64_t nominal_offset(uint64_t chunk, uint64_t chunks) const {
+        if (chunk >= chunks) {
+            return size_;
+        }
+        if (opts_.chunk_size != 0) {
+            return chunk * opts_.chunk_size;
+        }
+        const auto offset = static_cast<uint64_t>(
+          static_cast<unsigned __int128>(size_) * chunk / chunks);
+        return offset / page_size * page_size;
+    }
+
+    seastar::future<> run() {
+        if (opts_.zero_copy
+            && co_await seastar::with_scheduling_group(
+              opts_.write_group, [this] { return run_zero_copy(cuts_); })) {
+            co_return;
+        }
+        if (opts_.pipeline) {
+            co_await run_pipelined(cuts_, budget_);
+        } else {
+            co_await run_buffered(cuts_, budget_);
+        }
+    }
+
+    /*
+     * chunk boundaries of this shard: chunk k covers [cuts[k], cuts[k + 1]).
+     * every cut is the first record boundary at least chunk_limit bytes past
+     * the previous one, so with --split-on each chunk holds whole records and
+     * can be processed on its own.
+     */
+    seastar::future<std::vector<uint64_t>> plan_chunks(uint64_t chunk_limit) {
+        std::vector<uint64_t> cuts{start_};
+        while (cuts.back() < end_) {
+            cuts.push_back(std::min(
+              end_, co_await next_boundary(cuts.back() + chunk_limit)));
+        }
+        co_return cuts;
+    }
+
+    /*
+     * the first record boundary at or after pos. for newlines only the pages
+     * from pos - 1 up to the next '\n' are read, normally a single one, and
+     * searched with memchr, which glibc vectorises.
+     */
+    seastar::future<uint64_t> next_boundary(uint64_t pos) {
+        if (pos == 0 || pos >= size_) {
+            co_return std::min(pos, size_);
+        }
+        switch (opts_.split_on.type) {
+        case split_rule::kind::none:
+            co_return pos;
+        case split_rule::kind::record: {
+            const auto n = opts_.split_on.record_size;
+            co_return std::min(size_, (pos + n - 1) / n * n);
+        }
+        case split_rule::kind::newline:
+            break;
+        }
+        for (uint64_t offset = pos - 1; offset < size_;) {
+            const auto len = std::min<uint64_t>(
+              page_size - offset % page_size, size_ - offset);
+            const auto buf = co_await read_at(offset, len);
+            if (const auto* nl = static_cast<const char*>(
+                  std::memchr(buf.get(), '\n', buf.size()))) {
+                co_return offset + (nl - buf.get()) + 1;
             }
+            offset += len;
+        }
+        co_return size_;
+    }
+
+    /*
+     * zero-copy mode: every chunk is a byte range of the input, so it can be
+     * created without moving the data through user space. a FICLONERANGE
+     * reflink shares the extents (XFS, btrfs) and turns the split into a
+     * metadata operation; otherwise copy_file_range lets the kernel copy, or
+     * offload, the range. seastar::file exposes neither, so this path works
+     * on raw descriptors and copies read_size bytes per call, yielding in
+     * between to bound reactor stalls. returns false, before any byte is
+     * copied, when neither is supported so the caller falls back to the DMA
+     * path.
+     */
+    seastar::future<bool> run_zero_copy(const std::vector<uint64_t>& cuts) {
+        const file_descriptor input(
+          ::open(path_.c_str(), O_RDONLY | O_CLOEXEC));
+        if (!input) {
+            throw std::system_error(errno, std::system_category(), path_.string());
+        }
+        struct stat st {};
+        uint64_t block = page_size;
+        if (::fstat(input.get(), &st) == 0 && st.st_blksize > 0) {
+            block = static_cast<uint64_t>(st.st_blksize);
+        }
 
-            pages.push_back(std::move(buf));
+        bool reflink = true;
+        for (size_t chunk = 0; chunk + 1 < cuts.size(); ++chunk) {
+            const auto offset = cuts[chunk];
+            const auto len = cuts[chunk + 1] - offset;
+            const auto filename = chunk_name(chunk);
+            const file_descriptor output(::open(
+              filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+            if (!output) {
+                throw std::system_error(errno, std::system_category(), filename);
+            }
 
             /*
-             * keep reading until we've reached the memory limit or last page.
+             * FICLONERANGE wants block-aligned offsets and a block-aligned
+             * length, unless the range runs to the end of the input. a chunk
+             * starting on a block boundary has its whole blocks reflinked and
+             * its tail copied. one starting elsewhere, as --split-on and --cdc
+             * cuts do, is copied whole, and EINVAL for a single chunk does not
+             * turn reflinks off for the others. a zero length clones to the
+             * end of the input, so an empty chunk is just the new file.
              */
-            if (
-              pages.size() < pages_memory_limit
-              && curr_page_ != end_page_) {
+            uint64_t cloned = 0;
+            const auto body = offset + len == size_ ? len : len / block * block;
+            if (reflink && offset % block == 0 && body > 0) {
+                file_clone_range range{};
+                range.src_fd = input.get();
+                range.src_offset = offset;
+                range.src_length = body;
+                range.dest_offset = 0;
+                if (::ioctl(output.get(), FICLONERANGE, &range) == 0) {
+                    cloned = body;
+                    done_ += body;
+                } else if (errno == EINVAL) {
+                    lg.debug("Reflink of {} rejected, copying it", filename);
+                } else if (unsupported(errno)) {
+                    lg.debug(
+                      "Reflink unsupported ({}), using copy_file_range", errno);
+                    reflink = false;
+                } else {
+                    throw std::system_error(
+                      errno, std::system_category(), "FICLONERANGE " + filename);
+                }
+            }
+
+            if (!co_await copy_range(
+                  input, output, offset + cloned, cloned, len - cloned, filename)) {
+                manifest_.clear();
+                co_return false;
+            }
+            record_chunk(chunk, std::nullopt);
+        }
+        co_return true;
+    }
+
+    /*
+     * copy len bytes at in_off of the input to out_off of a chunk. returns
+     * false when copy_file_range is unsupported and this shard has not
+     * copied anything yet, so it can still switch to the DMA path.
+     */
+    seastar::future<bool> copy_range(
+      const file_descriptor& input,
+      const file_descriptor& output,
+      uint64_t in_offset,
+      uint64_t out_offset,
+      uint64_t len,
+      const std::string& filename) {
+        loff_t in_off = static_cast<loff_t>(in_offset);
+        loff_t out_off = static_cast<loff_t>(out_offset);
+        uint64_t left = len;
+        while (left > 0) {
+            const auto want = std::min<uint64_t>(left, opts_.read_size);
+            co_await seastar::when_all_succeed(
+              read_limit_.consume(want), write_limit_.consume(want))
+              .discard_result();
+            const auto n = ::copy_file_range(
+              input.get(), &in_off, output.get(), &out_off, want, 0);
+            if (n < 0 && errno == EINTR) {
                 continue;
             }
+            if (n < 0 && done_ == 0 && unsupported(errno)) {
+                lg.info(
+                  "copy_file_range unsupported ({}), using the DMA path", errno);
+                co_return false;
+            }
+            if (n <= 0) {
+                throw std::system_error(
+                  n < 0 ? errno : EIO,
+                  std::system_category(),
+                  "copy_file_range " + filename);
+            }
+            left -= static_cast<uint64_t>(n);
+            done_ += static_cast<uint64_t>(n);
+            co_await seastar::coroutine::maybe_yield();
+        }
+        co_return true;
+    }
+
+    /*
+     * errors meaning the filesystem or kernel lacks the operation, as opposed
+     * to the operation failing. EINVAL is left out: FICLONERANGE returns it
+     * for an unaligned range, which says nothing about the next chunk.
+     */
+    static bool unsupported(int err) {
+        return err == EOPNOTSUPP || err == ENOTTY || err == ENOSYS
+               || err == EXDEV;
+    }
+
+    seastar::future<>
+    run_buffered(const std::vector<uint64_t>& cuts, size_t budget_bytes) {
+        /*
+         * keep up to read_ahead bulk reads in flight ahead of the consumer so
+         * the device sees a queue of large requests instead of one synchronous
+         * 4 KiB round-trip per page. reads are consumed in file order, and a
+         * new one is issued as soon as the oldest completes.
+         */
+        const uint64_t end = end_;
+        uint64_t next_read = start_;
+        read_queue reads;
+        auto issue_reads = [&] {
+            while (reads.size() < opts_.read_ahead && next_read < end) {
+                const auto len = std::min<uint64_t>(
+                  opts_.read_size, end - next_read);
+                reads.push_back(read_at(next_read, len));
+                next_read += len;
+            }
+        };
+
+        /*
+         * collect a chunk's worth of data and then write it to a new chunk
+         * file. a read that straddles a cut is split between two chunks
+         * without copying. a chunk larger than the budget, which only an
+         * explicit layout or a long record produces, is written out in
+         * budget-sized parts instead. the chunk's checksum is computed from
+         * the buffers as they arrive, while they are still in cache.
+         */
+        size_t chunk = 0;
+        uint64_t pos = start_;
+        uint64_t buffered = 0;
+        uint32_t crc = 0;
+        seastar::chunked_fifo<buffer> pages;
+        chunk_stream output;
+        std::exception_ptr error;
+        try {
+            issue_reads();
+            while (!reads.empty()) {
+                auto buf = co_await std::move(reads.front());
+                reads.pop_front();
+                issue_reads();
+                done_ += buf.size();
+
+                while (!buf.empty()) {
+                    const auto n = std::min<uint64_t>(
+                      buf.size(), cuts[chunk + 1] - pos);
+                    crc = chunk_manifest::crc32c(crc, buf.get(), n);
+                    pages.push_back(buf.share(0, n));
+                    buf.trim_front(n);
+                    pos += n;
+                    buffered += n;
+                    const bool last = pos == cuts[chunk + 1];
+                    if (last || buffered >= budget_bytes) {
+                        co_await seastar::with_scheduling_group(
+                          opts_.write_group,
+                          [&, pages = std::exchange(pages, {})]() mutable {
+                              return write_chunk(
+                                chunk, std::move(pages), output, last);
+                          });
+                        buffered = 0;
+                    }
+                    if (last) {
+                        record_chunk(chunk++, std::exchange(crc, 0));
+                    }
+                }
+            }
+            co_await write_empty_chunks(chunk, cuts);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        co_await drain(reads);
+        if (error) {
+            if (output) {
+                co_await output->close().handle_exception(
+                  [](std::exception_ptr) {});
+            }
+            std::rethrow_exception(error);
+        }
+    }
+
+    /*
+     * pipelined mode: a reader fiber pushes buffers into a queue that a
+     * writer fiber drains into the current chunk file, so reading and writing
+     * overlap instead of alternating. a semaphore holding budget bytes worth
+     * of units bounds the data buffered between the two: the reader takes
+     * units before issuing a read and the writer returns them once the bytes
+     * are handed to the chunk's output stream. chunk files are the same as in
+     * the buffered mode.
+     */
+    seastar::future<>
+    run_pipelined(const std::vector<uint64_t>& cuts, size_t budget_bytes) {
+        const auto read_size = std::min(opts_.read_size, budget_bytes);
 
-            auto pages_to_write = std::exchange(pages, {});
+        seastar::semaphore budget(budget_bytes);
+        seastar::queue<buffer> queue(
+          std::max<size_t>(1, budget_bytes / read_size));
+
+        co_await seastar::when_all_succeed(
+          seastar::with_scheduling_group(
+            opts_.read_group,
+            [&] { return read_pipelined(budget, queue, read_size); }),
+          seastar::with_scheduling_group(
+            opts_.write_group,
+            [&] { return write_pipelined(budget, queue, cuts); }))
+          .discard_result();
+    }
+
+    seastar::future<> read_pipelined(
+      seastar::semaphore& budget,
+      seastar::queue<buffer>& queue,
+      size_t read_size) {
+        const uint64_t end = end_;
+        uint64_t next_read = start_;
+        read_queue reads;
+        std::exception_ptr error;
+        try {
+            while (true) {
+                /*
+                 * top up the reads in flight while the budget allows. block
+                 * on the budget only when nothing is in flight: completed
+                 * reads must keep flowing to the writer, which is what
+                 * returns the units.
+                 */
+                while (reads.size() < opts_.read_ahead && next_read < end) {
+                    const auto len = std::min<uint64_t>(
+                      read_size, end - next_read);
+                    if (reads.empty()) {
+                        co_await budget.wait(len);
+                    } else if (!budget.try_wait(len)) {
+                        break;
+                    }
+                    reads.push_back(read_at(next_read, len));
+                    next_read += len;
+                }
+                if (reads.empty()) {
+                    break;
+                }
+                auto buf = co_await std::move(reads.front());
+                reads.pop_front();
+                co_await queue.push_eventually(std::move(buf));
+            }
 
             /*
-             * open a file for this chunk which this core owns
+             * an empty buffer marks the end of this shard's range.
              */
-            const auto filename = fmt::format(
-              "chunk.core-{}.{}", seastar::this_shard_id(), chunk++);
+            co_await queue.push_eventually(buffer());
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        co_await drain(reads);
+        if (error) {
+            queue.abort(error);
+            std::rethrow_exception(error);
+        }
+    }
+
+    seastar::future<> write_pipelined(
+      seastar::semaphore& budget,
+      seastar::queue<buffer>& queue,
+      const std::vector<uint64_t>& cuts) {
+        size_t chunk = 0;
+        uint64_t pos = start_;
+        uint32_t crc = 0;
+        chunk_stream output;
+        std::exception_ptr error;
+        try {
+            while (true) {
+                auto buf = co_await queue.pop_eventually();
+                if (buf.empty()) {
+                    break;
+                }
+                while (!buf.empty()) {
+                    if (!output) {
+                        output = co_await seastar::make_file_output_stream(
+                          co_await open_chunk(chunk), stream_options());
+                    }
 
-            auto output = co_await seastar::open_file_dma(
-              filename,
-              seastar::open_flags::create | seastar::open_flags::truncate
-                | seastar::open_flags::wo);
+                    /*
+                     * with --split-on, cuts fall anywhere within a buffer, so
+                     * the output stream re-blocks the data into aligned DMA
+                     * writes (and pads and truncates the final partial page).
+                     */
+                    const auto n = std::min<uint64_t>(
+                      buf.size(), cuts[chunk + 1] - pos);
+                    crc = chunk_manifest::crc32c(crc, buf.get(), n);
+                    co_await write_limit_.consume(n);
+                    co_await output->write(buf.get(), n);
+                    pos += n;
+                    buf.trim_front(n);
+                    budget.signal(n);
+                    done_ += n;
+
+                    if (pos == cuts[chunk + 1]) {
+                        co_await output->flush();
+                        co_await output->close();
+                        output.reset();
+                        record_chunk(chunk++, std::exchange(crc, 0));
+                    }
+                }
+            }
+            co_await write_empty_chunks(chunk, cuts);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        if (error) {
+            if (output) {
+                co_await output->close().handle_exception(
+                  [](std::exception_ptr) {});
+            }
 
             /*
-             * stream the pages to the output chunk file.
+             * wake the reader if it is waiting for budget or queue space.
              */
-            auto ostream = co_await seastar::make_file_output_stream(
-              std::move(output));
+            budget.broken(error);
+            queue.abort(error);
+            std::rethrow_exception(error);
+        }
+    }
 
-            lg.debug(
-              "Dumping {} pages to file {}. Page buffering limit {}",
-              pages_to_write.size(),
-              filename,
-              pages_memory_limit);
+    /*
+     * create the files of the empty chunks left after the last byte of this
+     * shard's range, which no buffer reaches. they occur when record
+     * boundaries or --chunks rounding make neighbouring cuts coincide.
+     */
+    seastar::future<>
+    write_empty_chunks(size_t chunk, const std::vector<uint64_t>& cuts) {
+        for (; chunk + 1 < cuts.size(); ++chunk) {
+            auto file = co_await open_chunk(chunk);
+            co_await file.close();
+            record_chunk(chunk, 0);
+        }
+    }
 
-            for (auto& page : pages_to_write) {
-                co_await ostream.write(page.get(), page.size());
-            }
+    void record_chunk(size_t chunk, std::optional<uint32_t> crc) {
+        manifest_.push_back(chunk_manifest::entry{
+          .name = chunk_name(chunk),
+          .offset = cuts_[chunk],
+          .length = cuts_[chunk + 1] - cuts_[chunk],
+          .crc = crc});
+    }
+
+    /*
+     * chunk files are written in read_size blocks with up to read_ahead of
+     * them in flight, mirroring the read side.
+     */
+    seastar::file_output_stream_options stream_options() const {
+        seastar::file_output_stream_options options;
+        options.buffer_size = static_cast<unsigned>(opts_.read_size);
+        options.write_behind = static_cast<unsigned>(opts_.read_ahead);
+        return options;
+    }
+
+    /*
+     * the default layout numbers chunks per shard. an explicit layout and
+     * --cdc number them across the whole input, zero padded so they sort in
+     * file order.
+     */
+    std::string chunk_name(size_t chunk) const {
+        if (explicit_layout() || opts_.cdc) {
+            return fmt::format("chunk.{:0{}}", first_chunk_ + chunk, name_width_);
+        }
+        return fmt::format("chunk.core-{}.{}", seastar::this_shard_id(), chunk);
+    }
+
+    /*
+     * open the file for this shard's chunk number `chunk`.
+     */
+    seastar::future<seastar::file> open_chunk(size_t chunk) {
+        const auto filename = chunk_name(chunk);
+        co_return co_await seastar::open_file_dma(
+          filename,
+          seastar::open_flags::create | seastar::open_flags::truncate
+            | seastar::open_flags::wo);
+    }
+
+    /*
+     * wait for the reads still in flight after a failure so none of them is
+     * left running against a file that is about to be closed.
+     */
+    static seastar::future<> drain(read_queue& reads) {
+        for (auto& read : reads) {
+            co_await std::move(read).then_wrapped(
+              [](auto f) { f.ignore_ready_future(); });
+        }
+        reads.clear();
+    }
+
+    /*
+     * read len bytes at offset with a single bulk request. the dma-family of
+     * I/O interfaces require aligned memory, size, and file offsets, which
+     * dma_read_bulk takes care of for the buffer.
+     */
+    seastar::future<buffer> read_at(uint64_t offset, size_t len) {
+        co_await read_limit_.consume(len);
+        auto buf = co_await seastar::with_scheduling_group(
+          opts_.read_group,
+          [&] { return file_.dma_read_bulk<char>(offset, len); });
+
+        /*
+         * check for a short read. we don't handle it, but retrying or
+         * reading the remainder would be reasonable.
+         */
+        if (buf.size() != len) {
+            throw std::runtime_error(fmt::format(
+              "Short read with size {} != {} occurred at offset {}",
+              buf.size(),
+              len,
+              offset));
+        }
+        co_return buf;
+    }
+
+    /*
+     * stream pages to the chunk's file, opening it on the first call for the
+     * chunk. the file is closed once the `last` pages have been written.
+     */
+    seastar::future<> write_chunk(
+      size_t chunk,
+      seastar::chunked_fifo<buffer> pages,
+      chunk_stream& output,
+      bool last) {
+        lg.debug("Dumping {} buffers to chunk {}", pages.size(), chunk);
 
-            co_await ostream.flush();
-            co_await ostream.close();
+        if (!output) {
+            output = co_await seastar::make_file_output_stream(
+              co_await open_chunk(chunk), stream_options());
+        }
+
+        for (auto& page : pages) {
+            co_await write_limit_.consume(page.size());
+            co_await output->write(page.get(), page.size());
+        }
+
+        if (last) {
+            co_await output->flush();
+            co_await output->close();
+            output.reset();
         }
     }
 
     std::filesystem::path path_;
-    double memory_pct_;
+    splitter_options opts_;
     seastar::gate gate_;
     seastar::file file_;
-    size_t start_page_{0};
-    size_t end_page_{0};
-    size_t curr_page_{0};
+    uint64_t size_{0};
+    size_t budget_{0}; // --memory-pct of shard memory, in bytes
+    std::vector<uint64_t> cuts_; // chunk k covers [cuts_[k], cuts_[k + 1])
+    uint64_t first_chunk_{0};    // global number of chunk 0, explicit layout
+    size_t name_width_{0};       // digits in the largest global chunk number
+    std::optional<gear_chunker> chunker_; // --cdc planning only
+    std::vector<chunk_manifest::entry> manifest_;
+    rate_limiter read_limit_;
+    rate_limiter write_limit_;
+    uint64_t start_{0};
+    uint64_t end_{0};
+    uint64_t done_{0}; // bytes handed to chunks so far
+    bool failed_{false};
+    bool finished_{false}; // run() has resolved, successfully or not
 };
 
+/*
+ * --cdc layout. every shard chunks its nominal range in parallel, starting a
+ * chain of cuts at its first byte, then extends the chain into the following
+ * range until it meets a cut there (file_splitter::extend_content_defined).
+ * shard 0's chain is the true one, and each meeting point hands it over to
+ * the shard whose chain it met, so walking the meeting points from offset 0
+ * gives every shard the part of the true chain it writes. a shard whose
+ * range the true chain skips over writes nothing. the cuts are those of a
+ * sequential pass over the whole input.
+ */
+static seastar::future<>
+plan_content_defined(seastar::sharded<file_splitter>& splitter) {
+    const auto scans = co_await splitter.map(
+      [](file_splitter& splitter) { return splitter.scan_content_defined(); });
+    const auto meets = co_await splitter.map([&scans](file_splitter& splitter) {
+        return splitter.extend_content_defined(scans);
+    });
+
+    const auto shards = scans.size();
+    std::vector<uint64_t> begin(shards);
+    std::vector<uint64_t> end(shards);
+    uint64_t pos = 0;
+    size_t owner = 0;
+    for (size_t shard = 0; shard < shards; ++shard) {
+        begin[shard] = pos;
+        if (shard == owner) {
+            pos = meets[shard];
+            while (owner + 1 < shards && scans[owner + 1].front() <= pos) {
+                ++owner;
+            }
+            if (owner == shard) {
+                owner = shards;
+            }
+        }
+        end[shard] = pos;
+    }
+
+    const auto counts = co_await splitter.map(
+      [&begin, &end](file_splitter& splitter) {
+          const auto shard = seastar::this_shard_id();
+          return splitter.assign_content_defined(begin[shard], end[shard]);
+      });
+
+    std::vector<uint64_t> first(shards);
+    uint64_t chunks = 0;
+    for (size_t shard = 0; shard < shards; ++shard) {
+        first[shard] = chunks;
+        chunks += counts[shard];
+    }
+    const auto width = std::to_string(chunks > 0 ? chunks - 1 : 0).size();
+    co_await splitter.invoke_on_all([&first, width](file_splitter& splitter) {
+        splitter.number_chunks(first[seastar::this_shard_id()], width);
+    });
+}
+
+/*
+ * collect the shards' chunks, which tile the input in shard order, into the
+ * manifest at path.
+ */
+static seastar::future<>
+write_manifest(seastar::sharded<file_splitter>& splitter, std::string path) {
+    const auto parts = co_await splitter.map(
+      [](file_splitter& splitter) { return splitter.manifest(); });
+
+    std::string text(chunk_manifest::header);
+    size_t chunks = 0;
+    for (const auto& part : parts) {
+        for (const auto& entry : part) {
+            text += chunk_manifest::format_line(entry);
+            ++chunks;
+        }
+    }
+
+    auto output = co_await seastar::make_file_output_stream(
+      co_await seastar::open_file_dma(
+        path,
+        seastar::open_flags::create | seastar::open_flags::truncate
+          | seastar::open_flags::wo));
+    std::exception_ptr error;
+    try {
+        co_await output.write(text.data(), text.size());
+        co_await output.flush();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    co_await output.close();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    lg.info("Wrote manifest of {} chunks to {}", chunks, path);
+}
+
 /*
  * Monitor the progress of the splitter. This method expects that splitter has
  * already been started.
@@ -220,24 +1335,230 @@ int main(int argc, char** argv) {
           "memory-pct",
           po::value<double>()->default_value(20.0),
           "percent of shard memory to use");
-    }
 
-    return app.run(argc, argv, [&] {
+        /*
+         * --read-size <KiB> is the size of each dma_read_bulk request and
+         *  --read-ahead <n> the number of them kept in flight per shard. the
+         *  in-flight reads use up to read-size * read-ahead bytes on top of
+         *  the --memory-pct buffer.
+         */
+        app.add_options()(
+          "read-size",
+          po::value<size_t>()->default_value(1024),
+          "size of each read in KiB (multiple of 4)");
+        app.add_options()(
+          "read-ahead",
+          po::value<size_t>()->default_value(4),
+          "reads kept in flight per shard");
 
-        seastar::engine().at_exit([&splitter] { return splitter.stop(); });
+        /*
+         * --pipeline streams data to the chunk files while reading instead of
+         *  buffering a whole chunk first. --memory-pct then bounds the data
+         *  in flight between the reader and the writer, reads included.
+         */
+        app.add_options()(
+          "pipeline",
+          po::bool_switch()->default_value(false),
+          "overlap reading and writing");
 
+        /*
+         * --zero-copy creates the chunk files with FICLONERANGE reflinks or
+         *  copy_file_range instead of reading the data into memory, falling
+         *  back to the DMA path where neither is supported.
+         */
+        app.add_options()(
+          "zero-copy",
+          po::bool_switch()->default_value(false),
+          "create chunks with reflink / copy_file_range");
+
+        /*
+         * --split-on <rule> moves shard and chunk boundaries to the next
+         *  record boundary, so every chunk holds whole records: `newline`
+         *  cuts after a '\n', `record:<N>` on a multiple of N bytes. the
+         *  default, `none`, cuts anywhere.
+         */
+        app.add_options()(
+          "split-on",
+          po::value<std::string>()->default_value("none"),
+          "none, newline or record:<bytes>");
+
+        /*
+         * --chunk-size <bytes> (K, M, G or T suffix allowed) and --chunks <n>
+         *  fix the chunk layout instead of deriving it from --memory-pct:
+         *  chunks are numbered across the input as chunk.<n> and each shard
+         *  writes a contiguous run of them, so the output is the same for
+         *  any -c or -m. --memory-pct then only bounds the buffered data.
+         */
+        app.add_options()(
+          "chunk-size",
+          po::value<std::string>(),
+          "target chunk size in bytes, e.g. 64M");
+        app.add_options()(
+          "chunks", po::value<uint64_t>(), "number of chunks to create");
+
+        /*
+         * --cdc <avg> or <min>:<avg>:<max> cuts chunks where a rolling hash
+         *  of the content matches, so an insertion early in the input moves
+         *  only the boundaries near it. chunks are numbered like with
+         *  --chunk-size. the shards first scan the input to find the cuts,
+         *  which --zero-copy then turns into reflinks.
+         */
+        app.add_options()(
+          "cdc",
+          po::value<std::string>(),
+          "content-defined chunk sizes, <avg> or <min>:<avg>:<max>");
+
+        /*
+         * --manifest <file> lists every chunk with its offset, length and
+         *  CRC32C, computed while the data is in memory for the split
+         *  rather than by reading the chunks back. an empty name skips it.
+         */
+        app.add_options()(
+          "manifest",
+          po::value<std::string>()->default_value("chunks.manifest"),
+          "chunk manifest file, empty for none");
+
+        /*
+         * --max-read-mbps / --max-write-mbps <MiB/s> cap the input and chunk
+         *  bandwidth, so a split on a shared host leaves the disk to other
+         *  services. each shard gets a fixed 1/smp::count share, and a shard
+         *  that finishes early does not hand its share on, so the total can
+         *  stay below the cap. 0, the default, runs at full speed.
+         */
+        app.add_options()(
+          "max-read-mbps",
+          po::value<double>()->default_value(0),
+          "read bandwidth cap in MiB/s, 0 for none");
+        app.add_options()(
+          "max-write-mbps",
+          po::value<double>()->default_value(0),
+          "write bandwidth cap in MiB/s, 0 for none");
+    }
+
+    return app.run(argc, argv, [&] {
         auto& opts = app.configuration();
         const auto input = std::filesystem::path(
           opts["input"].as<seastar::sstring>());
-        const auto memory_pct = opts["memory-pct"].as<double>() / 100.0;
+        const auto split_on = parse_split_rule(
+          opts["split-on"].as<std::string>());
+        if (!split_on) {
+            lg.error(
+              "--split-on must be none, newline or record:<bytes>, got '{}'",
+              opts["split-on"].as<std::string>());
+            return seastar::make_ready_future<int>(1);
+        }
+        uint64_t chunk_size = 0;
+        if (opts.count("chunk-size")) {
+            const auto size = parse_size(opts["chunk-size"].as<std::string>());
+            if (!size || *size == 0) {
+                lg.error(
+                  "--chunk-size must be a positive byte count, got '{}'",
+                  opts["chunk-size"].as<std::string>());
+                return seastar::make_ready_future<int>(1);
+            }
+            chunk_size = *size;
+        }
+        const uint64_t chunks = opts.count("chunks")
+                                  ? opts["chunks"].as<uint64_t>()
+                                  : 0;
+        if (opts.count("chunks") && chunks == 0) {
+            lg.error("--chunks must be at least 1");
+            return seastar::make_ready_future<int>(1);
+        }
+        if (chunk_size != 0 && chunks != 0) {
+            lg.error("--chunk-size and --chunks are mutually exclusive");
+            return seastar::make_ready_future<int>(1);
+        }
+        cdc_params cdc;
+        if (opts.count("cdc")) {
+            const auto params = parse_cdc(opts["cdc"].as<std::string>());
+            if (!params) {
+                lg.error(
+                  "--cdc must be <avg> or <min>:<avg>:<max> with "
+                  "min <= avg <= max and avg >= 64, got '{}'",
+                  opts["cdc"].as<std::string>());
+                return seastar::make_ready_future<int>(1);
+            }
+            if (chunk_size != 0 || chunks != 0
+                || split_on->type != split_rule::kind::none) {
+                lg.error(
+                  "--cdc cannot be combined with --chunk-size, --chunks or "
+                  "--split-on");
+                return seastar::make_ready_future<int>(1);
+            }
+            cdc = *params;
+        }
+        const auto max_read_mbps = opts["max-read-mbps"].as<double>();
+        const auto max_write_mbps = opts["max-write-mbps"].as<double>();
+        if (max_read_mbps < 0 || max_write_mbps < 0) {
+            lg.error("--max-read-mbps and --max-write-mbps must not be negative");
+            return seastar::make_ready_future<int>(1);
+        }
+        splitter_options options{
+          .memory_pct = opts["memory-pct"].as<double>() / 100.0,
+          .read_size = opts["read-size"].as<size_t>() * 1024,
+          .read_ahead = opts["read-ahead"].as<size_t>(),
+          .pipeline = opts["pipeline"].as<bool>(),
+          .zero_copy = opts["zero-copy"].as<bool>(),
+          .split_on = *split_on,
+          .chunk_size = chunk_size,
+          .chunks = chunks,
+          .cdc = cdc,
+          .max_read_rate = static_cast<uint64_t>(
+            std::ceil(max_read_mbps * (1 << 20))),
+          .max_write_rate = static_cast<uint64_t>(
+            std::ceil(max_write_mbps * (1 << 20))),
+        };
+        if (options.read_size == 0 || options.read_size % 4096 != 0
+            || options.read_ahead == 0) {
+            lg.error(
+              "--read-size must be a positive multiple of 4 KiB and "
+              "--read-ahead at least 1");
+            return seastar::make_ready_future<int>(1);
+        }
+
+        seastar::engine().at_exit([&splitter] { return splitter.stop(); });
 
         lg.info("beginning...");
 
-        return splitter.start(input, memory_pct).then([&] {
-            return splitter.invoke_on_all(&file_splitter::start)
-              .then([&splitter] { return monitor(splitter); })
-              .then([] { return seastar::make_ready_future<int>(0); });
-        });
+        const auto manifest = opts["manifest"].as<std::string>();
+        return seastar::when_all_succeed(
+                 seastar::create_scheduling_group("split_read", 1000),
+                 seastar::create_scheduling_group("split_write", 1000))
+          .then_unpack([&splitter, input, options](
+                         seastar::scheduling_group read,
+                         seastar::scheduling_group write) mutable {
+              options.read_group = read;
+              options.write_group = write;
+              return splitter.start(input, options);
+          })
+          .then([&splitter, cdc, manifest] {
+              return splitter.invoke_on_all(&file_splitter::open)
+                .then([&splitter, cdc] {
+                    if (cdc) {
+                        return plan_content_defined(splitter);
+                    }
+                    return splitter.invoke_on_all(&file_splitter::plan);
+                })
+                .then([&splitter] {
+                    return splitter.invoke_on_all(&file_splitter::start);
+                })
+                .then([&splitter] { return monitor(splitter); })
+                .then([&splitter] {
+                    return splitter.map(
+                      [](file_splitter& splitter) { return splitter.failed(); });
+                })
+                .then([&splitter, manifest](std::vector<bool> failed) {
+                    const auto any_failed = std::any_of(
+                      failed.begin(), failed.end(), [](bool f) { return f; });
+                    if (any_failed || manifest.empty()) {
+                        return seastar::make_ready_future<int>(any_failed ? 1 : 0);
+                    }
+                    return write_manifest(splitter, manifest).then([] {
+                        return 0;
+                    });
+                });
+          });
     });
 
 }
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+
+/*
+ * the manifest big_file_splitter writes next to its chunks: one line per
+ * chunk, in input order, with the chunk's file name, its offset and length in
+ * the input and the CRC32C of its bytes, e.g.
+ *
+ *   chunk.003 201326592 67108864 8a9136aa
+ *
+ * the checksum is "-" for chunks created with --zero-copy, whose data never
+ * passes through memory. CRC32C (the Castagnoli polynomial, as in iSCSI and
+ * ext4) uses the SSE4.2 crc32 instruction when the CPU has it, eight bytes
+ * per instruction, and a table otherwise.
+ */
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+
+namespace chunk_manifest {
+
+constexpr std::string_view header = "# name offset length crc32c\n";
+
+namespace detail {
+
+constexpr std::array<uint32_t, 256> make_crc32c_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        auto crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+inline constexpr auto crc32c_table = make_crc32c_table();
+
+inline uint32_t crc32c_table_update(uint32_t crc, const char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        crc = crc32c_table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff]
+              ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) inline uint32_t
+crc32c_sse42_update(uint32_t crc, const char* data, size_t len) {
+    uint64_t crc64 = crc;
+    for (; len >= 8; data += 8, len -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; len > 0; ++data, --len) {
+        crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*data));
+    }
+    return crc;
+}
+#endif
+
+inline uint32_t gf2_matrix_times(const uint32_t* mat, uint32_t vec) {
+    uint32_t sum = 0;
+    for (; vec != 0; vec >>= 1, ++mat) {
+        if (vec & 1) {
+            sum ^= *mat;
+        }
+    }
+    return sum;
+}
+
+inline void gf2_matrix_square(uint32_t* square, const uint32_t* mat) {
+    for (int n = 0; n < 32; ++n) {
+        square[n] = gf2_matrix_times(mat, mat[n]);
+    }
+}
+
+} // namespace detail
+
+/*
+ * extend crc, the CRC32C of the bytes so far (0 for none), by len bytes.
+ */
+inline uint32_t crc32c(uint32_t crc, const char* data, size_t len) {
+#if defined(__x86_64__)
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    if (sse42) {
+        return ~detail::crc32c_sse42_update(~crc, data, len);
+    }
+#endif
+    return ~detail::crc32c_table_update(~crc, data, len);
+}
+
+/*
+ * the CRC32C of a concatenation from the CRC32Cs of its two parts and the
+ * length of the second, as zlib's crc32_combine does: the first CRC is
+ * advanced over len2 zero bytes by repeated squaring of the one-zero-bit
+ * operator, O(log len2).
+ */
+inline uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+    if (len2 == 0) {
+        return crc1;
+    }
+    uint32_t even[32];
+    uint32_t odd[32];
+    odd[0] = 0x82f63b78;
+    for (uint32_t n = 1, row = 1; n < 32; ++n, row <<= 1) {
+        odd[n] = row;
+    }
+    detail::gf2_matrix_square(even, odd); // two zero bits
+    detail::gf2_matrix_square(odd, even); // four zero bits
+    while (true) {
+        detail::gf2_matrix_square(even, odd);
+        if (len2 & 1) {
+            crc1 = detail::gf2_matrix_times(even, crc1);
+        }
+        len2 >>= 1;
+        if (len2 == 0) {
+            break;
+        }
+        detail::gf2_matrix_square(odd, even);
+        if (len2 & 1) {
+            crc1 = detail::gf2_matrix_times(odd, crc1);
+        }
+        len2 >>= 1;
+        if (len2 == 0) {
+            break;
+        }
+    }
+    return crc1 ^ crc2;
+}
+
+struct entry {
+    std::string name;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    std::optional<uint32_t> crc;
+};
+
+inline std::string format_line(const entry& e) {
+    if (e.crc) {
+        return fmt::format("{} {} {} {:08x}\n", e.name, e.offset, e.length, *e.crc);
+    }
+    return fmt::format("{} {} {} -\n", e.name, e.offset, e.length);
+}
+
+/*
+ * parse one line without its newline. comments and blank lines, like the
+ * header, yield nullopt, as do malformed lines; `malformed` tells them apart.
+ */
+inline std::optional<entry> parse_line(std::string_view line, bool& malformed) {
+    malformed = false;
+    if (line.empty() || line.front() == '#') {
+        return std::nullopt;
+    }
+
+    std::array<std::string_view, 4> fields;
+    for (auto& field : fields) {
+        const auto space = line.find(' ');
+        field = line.substr(0, space);
+        line = space == std::string_view::npos ? std::string_view{}
+                                                : line.substr(space + 1);
+    }
+
+    entry e{.name = std::string(fields[0])};
+    auto number = [](std::string_view text, auto& value, int base = 10) {
+        const auto [end, ec] = std::from_chars(
+          text.data(), text.data() + text.size(), value, base);
+        return ec == std::errc() && end == text.data() + text.size()
+               && !text.empty();
+    };
+    if (e.name.empty() || !line.empty() || !number(fields[1], e.offset)
+        || !number(fields[2], e.length)) {
+        malformed = true;
+        return std::nullopt;
+    }
+    if (fields[3] != "-") {
+        uint32_t crc = 0;
+        if (!number(fields[3], crc, 16)) {
+            malformed = true;
+            return std::nullopt;
+        }
+        e.crc = crc;
+    }
+    return e;
+}
+
+} // namespace chunk_manifest
@@ -22,8 +22,12 @@
 #include <chrono>
 #include <cstdint>
 #include <algorithm>
+#include <memory>
 
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_seastar_output.hpp"
+#include "prime_cache.hpp"
 
 namespace po = boost::program_options;
 
@@ -42,9 +46,17 @@ static AlignedAtomic g_next_task;
 
 // Per-shard result storage
 constexpr size_t kMaxCores = 128;
-struct alignas(64) PaddedResults { std::vector<task_result> results; };
+struct alignas(64) PaddedResults {
+    std::vector<task_result> results;
+    size_t streamed_tasks = 0;    // stream 模式下已交给写出端的任务数
+    size_t streamed_primes = 0;
+};
 static PaddedResults g_shard_results[kMaxCores];
 
+// stream 模式：shard 0 持有的有序写出端，为空时结果留在本地
+static std::unique_ptr<prime_seastar_output::OrderedStream> g_stream;
+static std::unique_ptr<prime_cache::ThreadCaches> g_cache;   // --cache-dir：每个 shard 各一组块
+
 static seastar::future<> worker_loop(unsigned shard_id, uint64_t range_start,
                                      uint64_t range_end, uint64_t interval,
                                      size_t total_tasks) {
@@ -59,8 +71,16 @@ static seastar::future<> worker_loop(unsigned shard_id, uint64_t range_start,
         uint64_t end = std::min(start + interval, range_end);
 
         return seastar::async([start, end, shard_id]() -> task_result {
-            return {start, end, shard_id, prime::segmented_sieve(start, end)};
-        }).then([shard_id](task_result r) mutable {
+            return {start, end, shard_id, prime_cache::sieve(start, end)};
+        }).then([shard_id, idx](task_result r) mutable {
+            if (g_stream) {
+                // 交给 shard 0 按任务号写出，窗口满时在此等待
+                auto& stats = g_shard_results[shard_id];
+                ++stats.streamed_tasks;
+                stats.streamed_primes += r.primes.size();
+                return prime_seastar_output::submit_ordered(g_stream.get(), idx, r.start, r.end, r.shard_id, r.primes)
+                    .then([] { return seastar::stop_iteration::no; });
+            }
             g_shard_results[shard_id].results.push_back(std::move(r));
             return seastar::make_ready_future<seastar::stop_iteration>(
                 seastar::stop_iteration::no);
@@ -68,11 +88,13 @@ static seastar::future<> worker_loop(unsigned shard_id, uint64_t range_start,
     });
 }
 
-static seastar::future<> output_results(const std::string& filename,
-                                         int num_tasks, int chunk_size,
-                                         long duration_ms) {
+static bool by_start(const task_result& a, const task_result& b) {
+    return a.start < b.start;
+}
+
+// 单写者：合并到 shard 0 排序后顺序写出
+static seastar::future<> write_single(const std::string& filename, prime_output::Format format) {
     std::vector<task_result> all_results;
-    size_t total_primes = 0;
     {
         size_t total = 0;
         unsigned num_cores = seastar::smp::count;
@@ -82,23 +104,51 @@ static seastar::future<> output_results(const std::string& filename,
         all_results.reserve(total);
         for (size_t i = 0; i < num_cores; ++i) {
             for (auto& r : g_shard_results[i].results) {
-                total_primes += r.primes.size();
                 all_results.push_back(std::move(r));
             }
             g_shard_results[i].results.clear();
         }
     }
 
-    std::sort(all_results.begin(), all_results.end(),
-              [](const task_result& a, const task_result& b) {
-                  return a.start < b.start;
-              });
+    std::sort(all_results.begin(), all_results.end(), by_start);
+
+    return seastar::async([filename, format, results = std::move(all_results)]() mutable {
+        auto f = seastar::open_file_dma(filename,
+            seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
+
+        // 行直接格式化进 DMA 缓冲，写满一块才提交一次
+        prime_seastar_output::DmaSink sink(std::move(f));
+        std::string header;
+        prime_output::append_file_header(format, header);
+        sink.write(header.data(), header.size());
+        for (const auto& r : results) {
+            sink.append_task(format, r.start, r.end, r.shard_id, r.primes);
+        }
+        sink.close();
+        prime_seastar_output::write_index(filename, format, sink.index());
+    });
+}
+
+static seastar::future<> output_results(const std::string& filename,
+                                         prime_output::Format format,
+                                         prime_output::OutputMode mode,
+                                         int num_tasks, int chunk_size,
+                                         long duration_ms) {
+    size_t completed = 0;
+    size_t total_primes = 0;
+    for (size_t i = 0; i < seastar::smp::count; ++i) {
+        completed += g_shard_results[i].results.size() + g_shard_results[i].streamed_tasks;
+        for (const auto& r : g_shard_results[i].results) {
+            total_primes += r.primes.size();
+        }
+        total_primes += g_shard_results[i].streamed_primes;
+    }
 
     uint64_t total_numbers = static_cast<uint64_t>(num_tasks) * chunk_size;
     std::cout << "\n========================================" << std::endl;
     std::cout << "          计算结果统计" << std::endl;
     std::cout << "========================================" << std::endl;
-    std::cout << "已完成任务: " << all_results.size() << "/" << num_tasks << std::endl;
+    std::cout << "已完成任务: " << completed << "/" << num_tasks << std::endl;
     std::cout << "素数总数:   " << total_primes << std::endl;
     std::cout << "计算耗时:   " << duration_ms << " ms" << std::endl;
 
@@ -112,40 +162,28 @@ static seastar::future<> output_results(const std::string& filename,
     }
     std::cout << "========================================" << std::endl;
 
-    return seastar::async([filename, results = std::move(all_results)]() mutable {
-        auto f = seastar::open_file_dma(filename,
-            seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
-        seastar::file_output_stream_options opts;
-        opts.buffer_size = 4 * 1024 * 1024;
-        auto out = seastar::make_file_output_stream(std::move(f), opts).get();
-
-        char tmp[21];
-        std::string line;
-        line.reserve(128 * 1024);
-        for (const auto& r : results) {
-            line.clear();
-            auto append_u64 = [&](uint64_t v) {
-                char* end = util::fast_uint64_to_str(v, tmp);
-                line.append(tmp, end - tmp);
-            };
-            append_u64(r.start);
-            line.push_back('-');
-            append_u64(r.end);
-            line.push_back(',');
-            append_u64(r.shard_id);
-            for (uint64_t prime : r.primes) {
-                line.push_back(',');
-                append_u64(prime);
-            }
-            line.push_back('\n');
-            out.write(line.data(), line.size()).get();
+    if (mode == prime_output::OutputMode::stream) {
+        // 结果已在计算中写出，等待窗口内剩余任务落盘
+        return g_stream->close().then([] {
+            std::cout << "重排缓冲峰值: " << g_stream->peak_pending() << " 个任务" << std::endl;
+            g_stream.reset();
+        });
+    }
+    if (mode == prime_output::OutputMode::single) {
+        return write_single(filename, format);
+    }
+    // 各 shard 在自己的核上编码并按偏移写出
+    return prime_seastar_output::write_sharded(filename, format, [](prime_seastar_output::ShardBuffer& buf) {
+        auto& local = g_shard_results[seastar::this_shard_id()].results;
+        std::sort(local.begin(), local.end(), by_start);
+        for (const auto& r : local) {
+            buf.add(r.start, r.end, r.shard_id, r.primes);
         }
-        out.flush().get();
-        out.close().get();
+        local.clear();
     });
 }
 
-static seastar::future<> seastar_main(const po::variables_map& config) {
+static seastar::future<int> seastar_main(const po::variables_map& config) {
     applog.set_level(seastar::log_level::error);
 
     int num_tasks = config["tasks"].as<int>();
@@ -163,8 +201,36 @@ static seastar::future<> seastar_main(const po::variables_map& config) {
     std::string output_file = config.count("output")
         ? config["output"].as<std::string>()
         : "dk4_seastar_prime.csv";
+    prime_output::Format format = prime_output::Format::csv;
+    if (!prime_output::parse_format(config["format"].as<std::string>(), format)) {
+        std::cerr << "错误: 无效的输出格式 " << config["format"].as<std::string>() << " (可选: csv, bin, bitmap)" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
+    if (config["output"].defaulted()) {
+        output_file = prime_output::with_extension(output_file, format);
+    }
+    prime_output::OutputMode mode = prime_output::OutputMode::sharded;
+    if (!prime_output::parse_output_mode(config["output-mode"].as<std::string>(), mode) ||
+        mode == prime_output::OutputMode::mmap) {
+        std::cerr << "错误: 无效的输出模式 " << config["output-mode"].as<std::string>() << " (可选: sharded, single, stream)" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
+    const std::string cache_dir = config["cache-dir"].as<std::string>();
+    if (!cache_dir.empty()) {
+        g_cache = std::make_unique<prime_cache::ThreadCaches>();
+        if (!g_cache->open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << g_cache->error() << std::endl;
+            return seastar::make_ready_future<int>(1);
+        }
+        prime_cache::install(g_cache.get());
+    }
+    if (format == prime_output::Format::bitmap && !prime_output::bitmap_compatible(chunk_size)) {
+        std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
 
-    uint64_t range_start = 2;
+    // bitmap 格式要求任务边界按 16 对齐，因此从 0 开始划分区间
+    uint64_t range_start = (format == prime_output::Format::bitmap) ? 0 : 2;
     uint64_t range_end = static_cast<uint64_t>(num_tasks) * chunk_size;
     uint64_t interval = chunk_size;
 
@@ -172,7 +238,7 @@ static seastar::future<> seastar_main(const po::variables_map& config) {
 
     unsigned num_cores = seastar::smp::count;
     for (size_t i = 0; i < num_cores; ++i) {
-        g_shard_results[i].results.clear();
+        g_shard_results[i] = PaddedResults{};
     }
 
     std::cout << "\n========================================" << std::endl;
@@ -184,21 +250,29 @@ static seastar::future<> seastar_main(const po::variables_map& config) {
     std::cout << "CPU核心数: " << num_cores << std::endl;
     std::cout << "========================================\n" << std::endl;
 
-    auto start_time = std::chrono::high_resolution_clock::now();
-
-    std::vector<seastar::future<>> workers;
-    workers.reserve(num_cores);
-    for (unsigned i = 0; i < num_cores; ++i) {
-        workers.push_back(
-            seastar::smp::submit_to(i, [i, range_start, range_end, interval,
-                                        total_tasks = static_cast<size_t>(num_tasks)] {
-                return worker_loop(i, range_start, range_end, interval, total_tasks);
-            })
-        );
+    // stream 模式：先打开有序写出端，worker 算完即可提交
+    auto opened = seastar::make_ready_future<>();
+    if (mode == prime_output::OutputMode::stream) {
+        g_stream = std::make_unique<prime_seastar_output::OrderedStream>();
+        opened = g_stream->open(output_file, format, prime_output::default_reorder_window(num_cores));
     }
 
-    return seastar::when_all(workers.begin(), workers.end()).then(
-        [num_tasks, chunk_size, output_file, start_time](std::vector<seastar::future<>> results) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    return opened.then([num_cores, range_start, range_end, interval, num_tasks] {
+        std::vector<seastar::future<>> workers;
+        workers.reserve(num_cores);
+        for (unsigned i = 0; i < num_cores; ++i) {
+            workers.push_back(
+                seastar::smp::submit_to(i, [i, range_start, range_end, interval,
+                                            total_tasks = static_cast<size_t>(num_tasks)] {
+                    return worker_loop(i, range_start, range_end, interval, total_tasks);
+                })
+            );
+        }
+        return seastar::when_all(workers.begin(), workers.end());
+    }).then(
+        [num_tasks, chunk_size, output_file, format, mode, start_time](std::vector<seastar::future<>> results) {
             for (auto& f : results) {
                 if (f.failed()) {
                     return seastar::make_exception_future<>(f.get_exception());
@@ -207,9 +281,9 @@ static seastar::future<> seastar_main(const po::variables_map& config) {
             auto end_time = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
                 end_time - start_time).count();
-            return output_results(output_file, num_tasks, chunk_size, duration);
+            return output_results(output_file, format, mode, num_tasks, chunk_size, duration);
         }
-    );
+    ).then([] { return 0; });
 }
 
 int main(int argc, char** argv) {
@@ -218,10 +292,19 @@ int main(int argc, char** argv) {
     app.add_options()
         ("tasks,t", po::value<int>()->default_value(32), "任务总数")
         ("chunk,n", po::value<int>()->default_value(100000), "每个任务的区间大小")
-        ("output,o", po::value<std::string>()->default_value("dk4_seastar_prime.csv"), "输出CSV文件路径")
+        ("output,o", po::value<std::string>()->default_value("dk4_seastar_prime.csv"), "输出文件路径 (bin/bitmap 格式默认 .bin/.bitmap)")
+        ("format,f", po::value<std::string>()->default_value("csv"), "输出格式 (csv/bin/bitmap)")
+        ("output-mode", po::value<std::string>()->default_value("sharded"), "写出方式 (sharded: 各 shard 按偏移并行写; single: 合并到 shard 0 顺序写; stream: 计算中按任务号有序写出)")
+        ("cache-dir", po::value<std::string>()->default_value(""), "持久素数缓存目录：已缓存的区间直接 mmap 读取，其余筛完后写入 (默认不启用)")
         ("log-level,l", po::value<std::string>(), "日志级别 (trace/debug/info/warn/error)");
 
     return app.run(argc, argv, [&app] {
-        return seastar_main(app.configuration());
+        return seastar_main(app.configuration()).then([](int status) {
+            if (status == 0 && g_cache) {
+                std::cout << "素数缓存: 命中 " << g_cache->hits() << " 块, 新筛 " << g_cache->misses()
+                          << " 块 (" << g_cache->dir() << ")" << std::endl;
+            }
+            return status;
+        });
     });
 }
@@ -10,12 +10,16 @@
 #include <atomic>
 #include <chrono>
 #include <string>
+#include <cstring>
 #include <optional>
 #include <iomanip>
 #include <algorithm>
 #include <memory>
 #include <getopt.h>
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_cache.hpp"
+#include "prime_mapped_file.hpp"
 
 // ============================================================================
 // 全局配置
@@ -100,6 +104,18 @@ static AlignedAtomicU64 g_total_primes;
 // unique_ptr 替代裸指针
 static std::unique_ptr<TaskQueue> g_task_queue;
 
+// bitmap 格式：worker 计算后直接 pwrite 到文件
+static prime_output::BitmapFile* g_bitmap = nullptr;
+
+// stream 模式：计算中按任务号有序写出，不保留结果
+static prime_output::OrderedWriter* g_stream = nullptr;
+
+// mmap 模式：g_task_offsets[i] 为任务 i 在输出文件中的起始偏移，末项为文件长度
+static std::vector<uint64_t> g_task_offsets;
+static prime_output::Format g_mapped_format = prime_output::Format::csv;
+static char* g_mapped_data = nullptr;
+static prime_output::IndexBuilder g_mapped_index;
+
 // ============================================================================
 // libfork 并行任务 - 工作窃取模式
 // ============================================================================
@@ -124,12 +140,21 @@ inline constexpr auto workerTask =
     uint64_t start = (task_id == 0) ? 2 : static_cast<uint64_t>(task_id) * g_config.chunk_size;
     uint64_t end = static_cast<uint64_t>(task_id + 1) * g_config.chunk_size;
 
-    // 计算该区间的素数
-    std::vector<uint64_t> primes = prime::segmented_sieve(start, end);
-    size_t count = primes.size();
-
-    // 收集结果到 per-thread 存储（无 mutex）
-    {
+    size_t count = 0;
+    std::vector<uint64_t> primes;
+    if (g_bitmap) {
+        // bitmap 格式：筛段直接写入文件，不提取素数
+        count = g_bitmap->sieve_and_write(start, end);
+    } else {
+        // 计算该区间的素数
+        primes = prime_cache::sieve(start, end);
+        count = primes.size();
+    }
+    if (g_stream) {
+        // stream 模式：编码后交给写线程，窗口满时在此等待
+        g_stream->submit(task_id, start, end, core_id, primes);
+    } else if (!g_bitmap) {
+        // 收集结果到 per-thread 存储（无 mutex）
         TaskResult result;
         result.task_id = task_id;
         result.start = start;
@@ -168,6 +193,48 @@ inline constexpr auto parallelCompute =
     co_await lf::join;
 };
 
+// ============================================================================
+// mmap 输出 - 每个 worker 处理一个线程的结果集，无共享缓冲
+// ============================================================================
+enum class MappedPass { size, format };
+
+// size：算出本线程各任务编码后的字节数，存入 g_task_offsets[task_id + 1]
+// format：在映射中该任务的偏移处原地编码，并填入该任务的索引条目
+inline constexpr auto mappedWorker =
+    [](auto, MappedPass pass, int thread_idx) -> lf::task<void> {
+    for (const auto& r : g_results_per_thread[thread_idx].results) {
+        if (pass == MappedPass::size) {
+            g_task_offsets[r.task_id + 1] = prime_output::task_size(
+                g_mapped_format, r.start, r.end, r.core_id, r.primes);
+        } else {
+            uint64_t offset = g_task_offsets[r.task_id];
+            g_mapped_index.set(r.task_id, r.start, r.end, offset, r.primes.size());
+            prime_output::write_task_at(g_mapped_format, g_mapped_data + offset,
+                                        g_task_offsets[r.task_id + 1] - offset,
+                                        r.start, r.end, r.core_id, r.primes);
+        }
+    }
+    co_return;
+};
+
+inline constexpr auto parallelMapped =
+    [](auto self, MappedPass pass, int remaining) -> lf::task<void> {
+
+    if (remaining <= 0) [[unlikely]] {
+        co_return;
+    }
+
+    if (remaining == 1) {
+        co_await lf::call[mappedWorker](pass, 0);
+        co_return;
+    }
+
+    co_await lf::fork[mappedWorker](pass, remaining - 1);
+    co_await lf::call[self](pass, remaining - 1);
+
+    co_await lf::join;
+};
+
 // ============================================================================
 // 功能函数：初始化任务队列
 // ============================================================================
@@ -203,10 +270,10 @@ std::unique_ptr<TaskQueue> initTaskQueue(int num_tasks, int chunk_size, int num_
 }
 
 // ============================================================================
-// 功能函数：输出计算结果到CSV文件
+// 功能函数：输出计算结果到文件（CSV 或二进制）
 // ============================================================================
-void outputResults(const std::string& filename) {
-    std::ofstream file(filename);
+void outputResults(const std::string& filename, prime_output::Format format) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
     if (!file.is_open()) [[unlikely]] {
         std::cerr << "错误: 无法打开输出文件 " << filename << std::endl;
         return;
@@ -234,23 +301,74 @@ void outputResults(const std::string& filename) {
                   return a.task_id < b.task_id;
               });
 
-    // 写入CSV
+    // 逐任务编码后写入，同时记录每个任务的偏移作为索引
+    std::string buffer;
+    buffer.reserve(128 * 1024);
+    prime_output::append_file_header(format, buffer);
+    prime_output::IndexBuilder index;
+    uint64_t offset = 0;
     for (const auto& result : all_results) {
-        // 第一字段：任务范围
-        file << result.start << "-" << result.end;
-        // 第二字段：CPU核编号
-        file << "," << result.core_id;
-        // 后续字段：素数列表
-        for (uint64_t prime : result.primes) {
-            file << "," << prime;
-        }
-        file << "\n";
+        index.add(result.start, result.end, offset + buffer.size(), result.primes.size());
+        prime_output::append_task(format, buffer, result.start, result.end,
+                                  result.core_id, result.primes);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        offset += buffer.size();
+        buffer.clear();
     }
 
     file.close();
+    index.set_data_size(offset);
+    if (!index.write(prime_output::index_path(filename), format)) {
+        std::cerr << "警告: 无法写入索引文件 " << prime_output::index_path(filename) << std::endl;
+    }
     std::cout << "结果已写入: " << filename << std::endl;
 }
 
+// ============================================================================
+// 功能函数：mmap 模式输出 - 按准确长度定长映射文件，各线程并行原地格式化
+// ============================================================================
+bool outputResultsMapped(lf::lazy_pool& pool, const std::string& filename, prime_output::Format format) {
+    std::cout << "\n正在写入结果文件: " << filename << " (mmap)" << std::endl;
+
+    std::string header;
+    prime_output::append_file_header(format, header);
+
+    // 1. 并行统计各任务字节数，再按任务号前缀和得到偏移
+    g_mapped_format = format;
+    g_task_offsets.assign(static_cast<size_t>(g_config.num_tasks) + 1, 0);
+    lf::sync_wait(pool, parallelMapped, MappedPass::size, g_config.num_threads);
+    g_task_offsets[0] = header.size();
+    for (size_t i = 1; i < g_task_offsets.size(); ++i) {
+        g_task_offsets[i] += g_task_offsets[i - 1];
+    }
+
+    // 2. 定长映射输出文件，各线程格式化自己的结果
+    prime_output::MappedFile file;
+    if (!file.open(filename, g_task_offsets.back())) {
+        std::cerr << "错误: 无法映射输出文件 " << filename << ": " << std::strerror(file.error()) << std::endl;
+        return false;
+    }
+    if (!header.empty()) std::memcpy(file.data(), header.data(), header.size());
+    g_mapped_data = file.data();
+    g_mapped_index.resize(g_task_offsets.size() - 1);
+    lf::sync_wait(pool, parallelMapped, MappedPass::format, g_config.num_threads);
+    g_mapped_data = nullptr;
+
+    if (!file.close()) {
+        std::cerr << "错误: 写入 " << filename << " 失败: " << std::strerror(file.error()) << std::endl;
+        return false;
+    }
+    for (int i = 0; i < kMaxThreads; ++i) {
+        g_results_per_thread[i].results.clear();
+    }
+    g_mapped_index.set_data_size(g_task_offsets.back());
+    if (!g_mapped_index.write(prime_output::index_path(filename), format)) {
+        std::cerr << "警告: 无法写入索引文件 " << prime_output::index_path(filename) << std::endl;
+    }
+    std::cout << "结果已写入: " << filename << " (" << g_task_offsets.back() << " 字节)" << std::endl;
+    return true;
+}
+
 // ============================================================================
 // 功能函数：打印统计结果
 // ============================================================================
@@ -286,10 +404,23 @@ int main(int argc, char** argv) {
     int num_tasks = 20;
     int chunk_size = 100000;
     int num_threads = 4;
+    prime_output::Format format = prime_output::Format::csv;
+    prime_output::OutputMode mode = prime_output::OutputMode::stream;
+    std::string cache_dir;
+
+    constexpr int kOptOutputMode = 256;
+    constexpr int kOptCacheDir = 257;
+    static const option long_options[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {"output-mode", required_argument, nullptr, kOptOutputMode},
+        {"cache-dir", required_argument, nullptr, kOptCacheDir},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
 
     // 解析命令行参数
     int opt;
-    while ((opt = getopt(argc, argv, "t:n:c:h")) != -1) {
+    while ((opt = getopt_long(argc, argv, "t:n:c:f:h", long_options, nullptr)) != -1) {
         switch (opt) {
             case 't':
                 try { num_tasks = std::stoi(optarg); }
@@ -303,13 +434,32 @@ int main(int argc, char** argv) {
                 try { num_threads = std::stoi(optarg); }
                 catch (const std::exception&) { std::cerr << "错误: 无效的 -c 参数" << std::endl; return 1; }
                 break;
+            case 'f':
+                if (!prime_output::parse_format(optarg, format)) {
+                    std::cerr << "错误: 无效的输出格式 " << optarg << " (可选: csv, bin, bitmap)" << std::endl;
+                    return 1;
+                }
+                break;
+            case kOptOutputMode:
+                if (!prime_output::parse_output_mode(optarg, mode) || mode == prime_output::OutputMode::sharded) {
+                    std::cerr << "错误: 无效的输出模式 " << optarg << " (可选: stream, single, mmap)" << std::endl;
+                    return 1;
+                }
+                break;
+            case kOptCacheDir:
+                cache_dir = optarg;
+                break;
             case 'h':
             default:
-                std::cout << "用法: " << argv[0] << " [-t 任务数] [-n 区间大小] [-c 线程数]\n" << std::endl;
+                std::cout << "用法: " << argv[0] << " [-t 任务数] [-n 区间大小] [-c 线程数] [-f csv|bin|bitmap] [--output-mode stream|single|mmap] [--cache-dir 目录]\n" << std::endl;
                 std::cout << "参数说明:" << std::endl;
                 std::cout << "  -t <N>   任务总数 (默认: 20)" << std::endl;
                 std::cout << "  -n <N>   区间大小，每任务计算的数字范围 (默认: 100000，最大: 100000)" << std::endl;
                 std::cout << "  -c <N>   CPU核数/线程数 (默认: 4)" << std::endl;
+                std::cout << "  -f, --format <F> 输出格式: csv、bin 或 bitmap (默认: csv，其余输出为 glm5_libfork_prime.<格式>)" << std::endl;
+                std::cout << "  --output-mode <M> stream: 计算中按任务号有序流式写出 (默认); single: 算完后排序统一写出;" << std::endl;
+                std::cout << "                    mmap: 算完后按准确长度映射输出文件，各线程并行原地格式化" << std::endl;
+                std::cout << "  --cache-dir <D> 持久素数缓存目录：已缓存的区间直接 mmap 读取，其余筛完后写入 (默认不启用)" << std::endl;
                 std::cout << "\n示例:" << std::endl;
                 std::cout << "  " << argv[0] << " -t 100 -n 100000 -c 8    # 100任务, 每任务10万, 8核" << std::endl;
                 std::cout << "  " << argv[0] << " -t 200 -n 50000 -c 16   # 200任务, 每任务5万, 16核" << std::endl;
@@ -326,6 +476,38 @@ int main(int argc, char** argv) {
     // 1. 初始化任务队列
     g_task_queue = initTaskQueue(num_tasks, chunk_size, num_threads);
 
+    // 缓存目录先于输出文件校验，无效时不留下被截断的空结果文件
+    prime_cache::Cache cache;
+    if (!cache_dir.empty()) {
+        if (!cache.open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << cache.error() << std::endl;
+            return 1;
+        }
+        prime_cache::install(&cache);
+    }
+
+    std::string output_file = prime_output::with_extension("glm5_libfork_prime.csv", format);
+    prime_output::BitmapFile bitmap;
+    if (format == prime_output::Format::bitmap) {
+        if (!prime_output::bitmap_compatible(chunk_size)) {
+            std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+            return 1;
+        }
+        if (!bitmap.open(output_file, static_cast<uint64_t>(num_tasks) * chunk_size)) {
+            std::cerr << "错误: 无法打开输出文件 " << output_file << ": " << std::strerror(bitmap.error()) << std::endl;
+            return 1;
+        }
+        g_bitmap = &bitmap;
+    }
+    prime_output::OrderedWriter stream;
+    if (format != prime_output::Format::bitmap && mode == prime_output::OutputMode::stream) {
+        if (!stream.open(output_file, format, prime_output::default_reorder_window(num_threads))) {
+            std::cerr << "错误: 无法打开输出文件 " << output_file << ": " << std::strerror(stream.error()) << std::endl;
+            return 1;
+        }
+        g_stream = &stream;
+    }
+
     // 2. 记录开始时间
     auto start_time = std::chrono::high_resolution_clock::now();
 
@@ -341,9 +523,30 @@ int main(int argc, char** argv) {
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-    // 5. 输出结果到CSV文件
-    std::string output_file = "glm5_libfork_prime.csv";
-    outputResults(output_file);
+    // 5. 输出结果到文件（bitmap 已在计算时写入）
+    if (g_bitmap) {
+        if (!bitmap.close()) {
+            std::cerr << "错误: 写入 " << output_file << " 失败: " << std::strerror(bitmap.error()) << std::endl;
+            return 1;
+        }
+        std::cout << "\n结果已写入: " << output_file << std::endl;
+    } else if (g_stream) {
+        if (!stream.close()) {
+            std::cerr << "错误: 写入 " << output_file << " 失败: " << std::strerror(stream.error()) << std::endl;
+            return 1;
+        }
+        std::cout << "\n结果已写入: " << output_file << " (重排缓冲峰值 " << stream.peak_pending() << " 个任务, "
+                  << stream.backend() << (stream.direct() ? " + O_DIRECT" : "") << ")" << std::endl;
+    } else if (mode == prime_output::OutputMode::mmap) {
+        if (!outputResultsMapped(pool, output_file, format)) return 1;
+    } else {
+        outputResults(output_file, format);
+    }
+
+    if (!cache_dir.empty()) {
+        std::cout << "素数缓存: 命中 " << cache.hits() << " 块, 新筛 " << cache.misses() << " 块 ("
+                  << cache_dir << ")" << std::endl;
+    }
 
     // 6. 打印统计结果
     printStatistics(duration.count());
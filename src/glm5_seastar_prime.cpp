@@ -22,8 +22,12 @@
 #include <chrono>
 #include <algorithm>
 #include <atomic>
+#include <memory>
 
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_seastar_output.hpp"
+#include "prime_cache.hpp"
 
 namespace ss = seastar;
 namespace po = boost::program_options;
@@ -78,9 +82,17 @@ public:
 };
 
 constexpr size_t kMaxCores = 128;
-struct alignas(64) PaddedResults { std::vector<TaskResult> results; };
+struct alignas(64) PaddedResults {
+    std::vector<TaskResult> results;
+    size_t streamed_tasks = 0;    // stream 模式下已交给写出端的任务数
+    size_t streamed_primes = 0;
+};
 static PaddedResults g_shard_results[kMaxCores];
 
+// stream 模式：core 0 持有的有序写出端，为空时结果留在本地
+static std::unique_ptr<prime_seastar_output::OrderedStream> g_stream;
+static std::unique_ptr<prime_cache::ThreadCaches> g_cache;   // --cache-dir：每个 shard 各一组块
+
 // core 0 持有的全局状态
 struct alignas(64) PaddedTaskStore { TaskStore store; };
 static PaddedTaskStore g_task_store;
@@ -93,72 +105,99 @@ static ss::future<> worker_loop(unsigned shard_id) {
             return ss::make_ready_future<ss::stop_iteration>(ss::stop_iteration::yes);
         }
         const Task* tasks = g_task_store.store.data() + s.begin;
+        if (g_stream) {
+            // 逐个计算并交给 core 0 有序写出，窗口满时在此等待
+            return ss::do_for_each(boost::irange<size_t>(0, s.count), [shard_id, tasks, s](size_t i) {
+                auto primes = prime_cache::sieve(tasks[i].start, tasks[i].end);
+                auto& stats = g_shard_results[shard_id];
+                ++stats.streamed_tasks;
+                stats.streamed_primes += primes.size();
+                return prime_seastar_output::submit_ordered(g_stream.get(), s.begin + i,
+                                                            tasks[i].start, tasks[i].end, shard_id, primes);
+            }).then([] { return ss::stop_iteration::no; });
+        }
         auto& local = g_shard_results[shard_id].results;
         local.reserve(local.size() + s.count);
         for (size_t i = 0; i < s.count; ++i) {
             local.emplace_back(tasks[i].start, tasks[i].end, shard_id,
-                               prime::segmented_sieve(tasks[i].start, tasks[i].end));
+                               prime_cache::sieve(tasks[i].start, tasks[i].end));
         }
         return ss::make_ready_future<ss::stop_iteration>(ss::stop_iteration::no);
     });
 }
 
-ss::future<> output_results(const std::string& filename, uint64_t max_num, long duration_ms) {
+static bool by_start(const TaskResult& a, const TaskResult& b) {
+    return a.start < b.start;
+}
+
+// 单写者：core 0 聚合所有 shard 的结果，排序后顺序写出
+static ss::future<> write_single(const std::string& filename, prime_output::Format format) {
     unsigned num_cores = ss::smp::count;
 
-    // core 0 聚合所有 shard 的结果
     std::vector<TaskResult> all_results;
-    size_t total_primes = 0;
     {
         size_t total = 0;
         for (size_t i = 0; i < num_cores; ++i) total += g_shard_results[i].results.size();
         all_results.reserve(total);
         for (size_t i = 0; i < num_cores; ++i) {
             for (auto& r : g_shard_results[i].results) {
-                total_primes += r.primes.size();
                 all_results.push_back(std::move(r));
             }
             g_shard_results[i].results.clear();
         }
     }
 
-    size_t total_tasks = g_task_store.store.size();
-
-    std::sort(all_results.begin(), all_results.end(),
-              [](const TaskResult& a, const TaskResult& b) {
-                  return a.start < b.start;
-              });
+    std::sort(all_results.begin(), all_results.end(), by_start);
 
-    return ss::async([filename, results = std::move(all_results)]() mutable {
+    return ss::async([filename, format, results = std::move(all_results)]() mutable {
         auto f = ss::open_file_dma(filename,
             ss::open_flags::wo | ss::open_flags::create | ss::open_flags::truncate).get();
-        ss::file_output_stream_options opts;
-        opts.buffer_size = 4 * 1024 * 1024;
-        auto out = ss::make_file_output_stream(std::move(f), opts).get();
-        char tmp[21];
-        std::string line;
-        line.reserve(128 * 1024);
+        // 行直接格式化进 DMA 缓冲，写满一块才提交一次
+        prime_seastar_output::DmaSink sink(std::move(f));
+        std::string header;
+        prime_output::append_file_header(format, header);
+        sink.write(header.data(), header.size());
         for (const auto& r : results) {
-            line.clear();
-            auto append_u64 = [&](uint64_t v) {
-                char* end = util::fast_uint64_to_str(v, tmp);
-                line.append(tmp, end - tmp);
-            };
-            append_u64(r.start);
-            line.push_back('-');
-            append_u64(r.end);
-            line.push_back(',');
-            append_u64(r.core_id);
-            for (uint64_t prime : r.primes) {
-                line.push_back(',');
-                append_u64(prime);
-            }
-            line.push_back('\n');
-            out.write(line.data(), line.size()).get();
+            sink.append_task(format, r.start, r.end, r.core_id, r.primes);
         }
-        out.flush().get();
-        out.close().get();
-    }).then([filename, max_num, duration_ms, total_primes, total_tasks]() {
+        sink.close();
+        prime_seastar_output::write_index(filename, format, sink.index());
+    });
+}
+
+// 多写者：各 shard 在自己的核上编码并按偏移写出
+static ss::future<> write_sharded(const std::string& filename, prime_output::Format format) {
+    return prime_seastar_output::write_sharded(filename, format, [](prime_seastar_output::ShardBuffer& buf) {
+        auto& local = g_shard_results[ss::this_shard_id()].results;
+        std::sort(local.begin(), local.end(), by_start);
+        for (const auto& r : local) {
+            buf.add(r.start, r.end, r.core_id, r.primes);
+        }
+        local.clear();
+    });
+}
+
+ss::future<> output_results(const std::string& filename, prime_output::Format format,
+                            prime_output::OutputMode mode, uint64_t max_num, long duration_ms) {
+    size_t total_primes = 0;
+    for (size_t i = 0; i < ss::smp::count; ++i) {
+        for (const auto& r : g_shard_results[i].results) total_primes += r.primes.size();
+        total_primes += g_shard_results[i].streamed_primes;
+    }
+    size_t total_tasks = g_task_store.store.size();
+
+    ss::future<> written = ss::make_ready_future<>();
+    if (mode == prime_output::OutputMode::stream) {
+        written = g_stream->close().then([] {
+            std::cout << "重排缓冲峰值: " << g_stream->peak_pending() << " 个任务" << std::endl;
+            g_stream.reset();
+        });
+    } else if (mode == prime_output::OutputMode::single) {
+        written = write_single(filename, format);
+    } else {
+        written = write_sharded(filename, format);
+    }
+    return written.then([filename, max_num, duration_ms, total_primes, total_tasks]() {
         std::cout << "结果已写入: " << filename << std::endl;
 
         double prime_density = 100.0 * total_primes / max_num;
@@ -182,12 +221,20 @@ ss::future<> output_results(const std::string& filename, uint64_t max_num, long
     });
 }
 
-ss::future<> seastar_main(const po::variables_map& config) {
+ss::future<int> seastar_main(const po::variables_map& config) {
     app_log.set_level(ss::log_level::error);
 
     int num_tasks = config["tasks"].as<int>();
     int chunk_size = config["chunk"].as<int>();
     std::string output_file = config["output"].as<std::string>();
+    prime_output::Format format = prime_output::Format::csv;
+    if (!prime_output::parse_format(config["format"].as<std::string>(), format)) {
+        std::cerr << "错误: 无效的输出格式 " << config["format"].as<std::string>() << " (可选: csv, bin, bitmap)" << std::endl;
+        return ss::make_ready_future<int>(1);
+    }
+    if (config["output"].defaulted()) {
+        output_file = prime_output::with_extension(output_file, format);
+    }
 
     if (config.count("log-level")) {
         std::string level = config["log-level"].as<std::string>();
@@ -198,6 +245,25 @@ ss::future<> seastar_main(const po::variables_map& config) {
 
     if (num_tasks <= 0) num_tasks = 20;
     if (chunk_size <= 0) chunk_size = 100000;
+    prime_output::OutputMode mode = prime_output::OutputMode::sharded;
+    if (!prime_output::parse_output_mode(config["output-mode"].as<std::string>(), mode) ||
+        mode == prime_output::OutputMode::mmap) {
+        std::cerr << "错误: 无效的输出模式 " << config["output-mode"].as<std::string>() << " (可选: sharded, single, stream)" << std::endl;
+        return ss::make_ready_future<int>(1);
+    }
+    const std::string cache_dir = config["cache-dir"].as<std::string>();
+    if (!cache_dir.empty()) {
+        g_cache = std::make_unique<prime_cache::ThreadCaches>();
+        if (!g_cache->open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << g_cache->error() << std::endl;
+            return ss::make_ready_future<int>(1);
+        }
+        prime_cache::install(g_cache.get());
+    }
+    if (format == prime_output::Format::bitmap && !prime_output::bitmap_compatible(chunk_size)) {
+        std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+        return ss::make_ready_future<int>(1);
+    }
 
     uint64_t max_num = static_cast<uint64_t>(num_tasks) * chunk_size;
 
@@ -208,7 +274,7 @@ ss::future<> seastar_main(const po::variables_map& config) {
         g_task_store.store.init(max_num, chunk_size);
 
         for (size_t i = 0; i < ss::smp::count; ++i) {
-            g_shard_results[i].results.clear();
+            g_shard_results[i] = PaddedResults{};
         }
 
         std::cout << "\n========================================" << std::endl;
@@ -222,6 +288,10 @@ ss::future<> seastar_main(const po::variables_map& config) {
         std::cout << "开始并行计算...\n" << std::endl;
         return ss::make_ready_future<>();
 
+    }).then([output_file, format, mode] {
+        if (mode != prime_output::OutputMode::stream) return ss::make_ready_future<>();
+        g_stream = std::make_unique<prime_seastar_output::OrderedStream>();
+        return g_stream->open(output_file, format, prime_output::default_reorder_window(ss::smp::count, 32));
     }).then([] {
         std::vector<ss::future<>> futures;
         futures.reserve(ss::smp::count);
@@ -234,12 +304,12 @@ ss::future<> seastar_main(const po::variables_map& config) {
         }
         return ss::when_all(futures.begin(), futures.end()).discard_result();
 
-    }).then([start_time, max_num, output_file] {
+    }).then([start_time, max_num, output_file, format, mode] {
         // core 0 收集聚合结果
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        return output_results(output_file, max_num, duration.count());
-    });
+        return output_results(output_file, format, mode, max_num, duration.count());
+    }).then([] { return 0; });
 }
 
 int main(int argc, char** argv) {
@@ -248,10 +318,19 @@ int main(int argc, char** argv) {
     app.add_options()
         ("tasks,t", po::value<int>()->default_value(20), "任务总数")
         ("chunk,n", po::value<int>()->default_value(100000), "每个任务的区间大小")
-        ("output,o", po::value<std::string>()->default_value("glm5_seastar_prime.csv"), "输出CSV文件路径")
+        ("output,o", po::value<std::string>()->default_value("glm5_seastar_prime.csv"), "输出文件路径 (bin/bitmap 格式默认 .bin/.bitmap)")
+        ("format,f", po::value<std::string>()->default_value("csv"), "输出格式 (csv/bin/bitmap)")
+        ("output-mode", po::value<std::string>()->default_value("sharded"), "写出方式 (sharded: 各 shard 按偏移并行写; single: 合并到 core 0 顺序写; stream: 计算中按任务号有序写出)")
+        ("cache-dir", po::value<std::string>()->default_value(""), "持久素数缓存目录：已缓存的区间直接 mmap 读取，其余筛完后写入 (默认不启用)")
         ("log-level,l", po::value<std::string>(), "日志级别 (debug/info/error/trace)");
 
     return app.run(argc, argv, [&app] {
-        return seastar_main(app.configuration());
+        return seastar_main(app.configuration()).then([](int status) {
+            if (status == 0 && g_cache) {
+                std::cout << "素数缓存: 命中 " << g_cache->hits() << " 块, 新筛 " << g_cache->misses()
+                          << " 块 (" << g_cache->dir() << ")" << std::endl;
+            }
+            return status;
+        });
     });
 }
@@ -24,6 +24,9 @@
 #include <iomanip>
 #include <chrono>
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_seastar_output.hpp"
+#include "prime_cache.hpp"
 
 namespace po = boost::program_options;
 
@@ -61,9 +64,17 @@ public:
 };
 
 constexpr size_t kMaxCores = 128;
-struct alignas(64) PaddedResults { std::vector<task_result> results; };
+struct alignas(64) PaddedResults {
+    std::vector<task_result> results;
+    size_t streamed_tasks = 0;    // tasks handed to the ordered stream (stream mode)
+    size_t streamed_primes = 0;
+};
 static PaddedResults g_shard_results[kMaxCores];
 
+// Ordered writer owned by shard 0 in stream mode; null otherwise
+static std::unique_ptr<prime_seastar_output::OrderedStream> g_stream;
+static std::unique_ptr<prime_cache::ThreadCaches> g_cache;   // --cache-dir：每个 shard 各一组块
+
 static seastar::future<> worker_loop(task_queue* queue, unsigned shard_id, size_t batch_size) {
     return seastar::repeat([queue, shard_id, batch_size] {
         task_queue::slot s = queue->pop_tasks(batch_size);
@@ -71,10 +82,21 @@ static seastar::future<> worker_loop(task_queue* queue, unsigned shard_id, size_
             return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
         }
         const range_task* tasks = queue->data() + s.begin;
+        if (g_stream) {
+            // Sieve one task at a time and hand it to shard 0; waits while the reorder window is full
+            return seastar::do_for_each(boost::irange<size_t>(0, s.count), [shard_id, tasks, s](size_t i) {
+                auto primes = prime_cache::sieve(tasks[i].start, tasks[i].end);
+                auto& stats = g_shard_results[shard_id];
+                ++stats.streamed_tasks;
+                stats.streamed_primes += primes.size();
+                return prime_seastar_output::submit_ordered(g_stream.get(), s.begin + i,
+                                                            tasks[i].start, tasks[i].end, shard_id, primes);
+            }).then([] { return seastar::stop_iteration::no; });
+        }
         auto& local = g_shard_results[shard_id].results;
         local.reserve(local.size() + s.count);
         for (size_t i = 0; i < s.count; ++i) {
-            local.push_back({tasks[i], shard_id, prime::segmented_sieve(tasks[i].start, tasks[i].end)});
+            local.push_back({tasks[i], shard_id, prime_cache::sieve(tasks[i].start, tasks[i].end)});
         }
         return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::no);
     });
@@ -92,11 +114,13 @@ static std::unique_ptr<task_queue> initialize_task_queue(int num_tasks, int chun
     return queue;
 }
 
-static seastar::future<> output_results(const std::string& filename,
-                                         int num_tasks, int chunk_size, long duration_ms) {
-    // Aggregate per-shard results
+static bool by_start(const task_result& a, const task_result& b) {
+    return a.task.start < b.task.start;
+}
+
+// Single writer: merge onto shard 0, sort, stream out
+static seastar::future<> write_single(const std::string& filename, prime_output::Format format) {
     std::vector<task_result> all_results;
-    size_t total_primes = 0;
     {
         size_t total = 0;
         unsigned num_cores = seastar::smp::count;
@@ -104,7 +128,6 @@ static seastar::future<> output_results(const std::string& filename,
         all_results.reserve(total);
         for (size_t i = 0; i < num_cores; ++i) {
             for (auto& r : g_shard_results[i].results) {
-                total_primes += r.primes.size();
                 all_results.push_back(std::move(r));
             }
             g_shard_results[i].results.clear();
@@ -112,16 +135,41 @@ static seastar::future<> output_results(const std::string& filename,
     }
 
     // Sort by range start
-    std::sort(all_results.begin(), all_results.end(),
-              [](const task_result& a, const task_result& b) {
-                  return a.task.start < b.task.start;
-              });
+    std::sort(all_results.begin(), all_results.end(), by_start);
+
+    return seastar::async([filename, format, results = std::move(all_results)]() mutable {
+        auto f = seastar::open_file_dma(filename,
+            seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
+        // Rows are formatted straight into DMA buffers; one dma_write per filled buffer
+        prime_seastar_output::DmaSink sink(std::move(f));
+        std::string header;
+        prime_output::append_file_header(format, header);
+        sink.write(header.data(), header.size());
+        for (const auto& r : results) {
+            sink.append_task(format, r.task.start, r.task.end, r.shard_id, r.primes);
+        }
+        sink.close();
+        prime_seastar_output::write_index(filename, format, sink.index());
+    });
+}
+
+static seastar::future<> output_results(const std::string& filename, prime_output::Format format,
+                                         prime_output::OutputMode mode,
+                                         int num_tasks, int chunk_size, long duration_ms) {
+    // Per-shard totals (results stay on their shards for the sharded writer)
+    size_t completed = 0;
+    size_t total_primes = 0;
+    for (size_t i = 0; i < seastar::smp::count; ++i) {
+        completed += g_shard_results[i].results.size() + g_shard_results[i].streamed_tasks;
+        for (const auto& r : g_shard_results[i].results) total_primes += r.primes.size();
+        total_primes += g_shard_results[i].streamed_primes;
+    }
 
     // Print statistics
     std::cout << "\n========================================" << std::endl;
     std::cout << "         计算结果统计" << std::endl;
     std::cout << "========================================" << std::endl;
-    std::cout << "已完成任务: " << all_results.size() << "/" << num_tasks << std::endl;
+    std::cout << "已完成任务: " << completed << "/" << num_tasks << std::endl;
     std::cout << "素数总数:   " << total_primes << std::endl;
     std::cout << "计算耗时:   " << duration_ms << " ms" << std::endl;
 
@@ -137,39 +185,28 @@ static seastar::future<> output_results(const std::string& filename,
     }
     std::cout << "========================================" << std::endl;
 
-    return seastar::async([filename, results = std::move(all_results)]() mutable {
-        auto f = seastar::open_file_dma(filename,
-            seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
-        seastar::file_output_stream_options opts;
-        opts.buffer_size = 4 * 1024 * 1024;
-        auto out = seastar::make_file_output_stream(std::move(f), opts).get();
-        char tmp[21];
-        std::string line;
-        line.reserve(128 * 1024);
-        for (const auto& r : results) {
-            line.clear();
-            auto append_u64 = [&](uint64_t v) {
-                char* end = util::fast_uint64_to_str(v, tmp);
-                line.append(tmp, end - tmp);
-            };
-            append_u64(r.task.start);
-            line.push_back('-');
-            append_u64(r.task.end);
-            line.push_back(',');
-            append_u64(r.shard_id);
-            for (uint64_t prime : r.primes) {
-                line.push_back(',');
-                append_u64(prime);
-            }
-            line.push_back('\n');
-            out.write(line.data(), line.size()).get();
+    if (mode == prime_output::OutputMode::stream) {
+        // Everything was written during the computation; wait for the tail
+        return g_stream->close().then([] {
+            std::cout << "重排缓冲峰值: " << g_stream->peak_pending() << " 个任务" << std::endl;
+            g_stream.reset();
+        });
+    }
+    if (mode == prime_output::OutputMode::single) {
+        return write_single(filename, format);
+    }
+    // Each shard encodes its own tasks and writes them at their file offsets
+    return prime_seastar_output::write_sharded(filename, format, [](prime_seastar_output::ShardBuffer& buf) {
+        auto& local = g_shard_results[seastar::this_shard_id()].results;
+        std::sort(local.begin(), local.end(), by_start);
+        for (const auto& r : local) {
+            buf.add(r.task.start, r.task.end, r.shard_id, r.primes);
         }
-        out.flush().get();
-        out.close().get();
+        local.clear();
     });
 }
 
-static seastar::future<> seastar_main(const po::variables_map& config) {
+static seastar::future<int> seastar_main(const po::variables_map& config) {
     applog.set_level(seastar::log_level::error);
 
     int num_tasks = config["tasks"].as<int>();
@@ -187,10 +224,37 @@ static seastar::future<> seastar_main(const po::variables_map& config) {
     }
 
     std::string output_file = config.count("output") ? config["output"].as<std::string>() : "kimi_seastar_prime.csv";
+    prime_output::Format format = prime_output::Format::csv;
+    if (!prime_output::parse_format(config["format"].as<std::string>(), format)) {
+        std::cerr << "错误: 无效的输出格式 " << config["format"].as<std::string>() << " (可选: csv, bin, bitmap)" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
+    if (config["output"].defaulted()) {
+        output_file = prime_output::with_extension(output_file, format);
+    }
+    prime_output::OutputMode mode = prime_output::OutputMode::sharded;
+    if (!prime_output::parse_output_mode(config["output-mode"].as<std::string>(), mode) ||
+        mode == prime_output::OutputMode::mmap) {
+        std::cerr << "错误: 无效的输出模式 " << config["output-mode"].as<std::string>() << " (可选: sharded, single, stream)" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
+    const std::string cache_dir = config["cache-dir"].as<std::string>();
+    if (!cache_dir.empty()) {
+        g_cache = std::make_unique<prime_cache::ThreadCaches>();
+        if (!g_cache->open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << g_cache->error() << std::endl;
+            return seastar::make_ready_future<int>(1);
+        }
+        prime_cache::install(g_cache.get());
+    }
+    if (format == prime_output::Format::bitmap && !prime_output::bitmap_compatible(chunk_size)) {
+        std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
 
     // Clear per-shard results
     for (size_t i = 0; i < num_cores; ++i) {
-        g_shard_results[i].results.clear();
+        g_shard_results[i] = PaddedResults{};
     }
 
     std::cout << "\n========================================" << std::endl;
@@ -202,35 +266,44 @@ static seastar::future<> seastar_main(const po::variables_map& config) {
     std::cout << "CPU核心数: " << num_cores << std::endl;
     std::cout << "========================================\n" << std::endl;
 
+    // Stream mode: open the ordered writer before any worker can finish a task
+    auto opened = seastar::make_ready_future<>();
+    if (mode == prime_output::OutputMode::stream) {
+        g_stream = std::make_unique<prime_seastar_output::OrderedStream>();
+        opened = g_stream->open(output_file, format, prime_output::default_reorder_window(num_cores, 32));
+    }
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    return seastar::do_with(
-        initialize_task_queue(num_tasks, chunk_size),
-        [num_tasks, chunk_size, output_file, start_time](std::unique_ptr<task_queue>& queue) {
-            std::vector<seastar::future<>> workers;
-            workers.reserve(seastar::smp::count);
-            for (unsigned i = 0; i < seastar::smp::count; ++i) {
-                workers.push_back(
-                    seastar::smp::submit_to(i, [queue = queue.get(), i] {
-                        return worker_loop(queue, i, 32);
-                    })
-                );
-            }
+    return opened.then([num_tasks, chunk_size, output_file, format, mode, start_time] {
+        return seastar::do_with(
+            initialize_task_queue(num_tasks, chunk_size),
+            [num_tasks, chunk_size, output_file, format, mode, start_time](std::unique_ptr<task_queue>& queue) {
+                std::vector<seastar::future<>> workers;
+                workers.reserve(seastar::smp::count);
+                for (unsigned i = 0; i < seastar::smp::count; ++i) {
+                    workers.push_back(
+                        seastar::smp::submit_to(i, [queue = queue.get(), i] {
+                            return worker_loop(queue, i, 32);
+                        })
+                    );
+                }
 
-            return seastar::when_all(workers.begin(), workers.end()).then(
-                [num_tasks, chunk_size, output_file, start_time](std::vector<seastar::future<>> results) mutable {
-                    for (auto& f : results) {
-                        if (f.failed()) {
-                            return seastar::make_exception_future<>(f.get_exception());
+                return seastar::when_all(workers.begin(), workers.end()).then(
+                    [num_tasks, chunk_size, output_file, format, mode, start_time](std::vector<seastar::future<>> results) mutable {
+                        for (auto& f : results) {
+                            if (f.failed()) {
+                                return seastar::make_exception_future<>(f.get_exception());
+                            }
                         }
+                        auto end_time = std::chrono::high_resolution_clock::now();
+                        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+                        return output_results(output_file, format, mode, num_tasks, chunk_size, duration.count());
                     }
-                    auto end_time = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-                    return output_results(output_file, num_tasks, chunk_size, duration.count());
-                }
-            );
-        }
-    );
+                );
+            }
+        );
+    }).then([] { return 0; });
 }
 
 int main(int argc, char** argv) {
@@ -239,10 +312,19 @@ int main(int argc, char** argv) {
     app.add_options()
         ("tasks,t", po::value<int>()->default_value(20), "任务总数")
         ("chunk,n", po::value<int>()->default_value(100000), "每个任务的区间大小")
-        ("output,o", po::value<std::string>()->default_value("kimi_seastar_prime.csv"), "输出CSV文件路径")
+        ("output,o", po::value<std::string>()->default_value("kimi_seastar_prime.csv"), "输出文件路径 (bin/bitmap 格式默认 .bin/.bitmap)")
+        ("format,f", po::value<std::string>()->default_value("csv"), "输出格式 (csv/bin/bitmap)")
+        ("output-mode", po::value<std::string>()->default_value("sharded"), "写出方式 (sharded: 各 shard 按偏移并行写; single: 合并到 shard 0 顺序写; stream: 计算中按任务号有序写出)")
+        ("cache-dir", po::value<std::string>()->default_value(""), "持久素数缓存目录：已缓存的区间直接 mmap 读取，其余筛完后写入 (默认不启用)")
         ("log-level,l", po::value<std::string>(), "日志级别 (debug/info/error/trace)");
 
     return app.run(argc, argv, [&app] {
-        return seastar_main(app.configuration());
+        return seastar_main(app.configuration()).then([](int status) {
+            if (status == 0 && g_cache) {
+                std::cout << "素数缓存: 命中 " << g_cache->hits() << " 块, 新筛 " << g_cache->misses()
+                          << " 块 (" << g_cache->dir() << ")" << std::endl;
+            }
+            return status;
+        });
     });
 }
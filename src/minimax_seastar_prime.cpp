@@ -24,6 +24,9 @@
 #include <memory>
 
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_seastar_output.hpp"
+#include "prime_cache.hpp"
 
 namespace po = boost::program_options;
 
@@ -72,6 +75,10 @@ constexpr size_t kMaxCores = 128;
 struct alignas(64) PaddedResults { std::vector<TaskResult> results; };
 static PaddedResults g_results_per_core[kMaxCores];
 
+// stream 模式：核 0 持有的有序写出端，为空时结果留在本核
+static std::unique_ptr<prime_seastar_output::OrderedStream> g_stream;
+static std::unique_ptr<prime_cache::Cache> g_cache;   // --cache-dir：各 shard 共用
+
 // 工作核心函数：使用 seastar::repeat 循环处理任务
 seastar::future<> workerCoreLoop(int core_id) {
     return seastar::repeat([core_id] {
@@ -94,7 +101,7 @@ seastar::future<> workerCoreLoop(int core_id) {
 
         // 使用 seastar::async 在后台线程中计算素数，避免阻塞 reactor
         return seastar::async([task, core_id] {
-            return prime::segmented_sieve(task.start, task.end);
+            return prime_cache::sieve(task.start, task.end);
         }).then([task, core_id](std::vector<uint64_t> primes) -> seastar::future<seastar::stop_iteration> {
             size_t count = primes.size();
 
@@ -103,6 +110,13 @@ seastar::future<> workerCoreLoop(int core_id) {
             // H3: uint64_t 素数总数
             g_total_primes.value.fetch_add(static_cast<uint64_t>(count), std::memory_order_relaxed);
 
+            if (g_stream) {
+                // 交给核 0 按任务ID写出，窗口满时在此等待
+                return prime_seastar_output::submit_ordered(g_stream.get(), task.task_id, task.start, task.end,
+                                                            core_id, primes)
+                    .then([] { return seastar::stop_iteration::no; });
+            }
+
             // C2: 直接写入 per-core 结果数组，无需 mutex
             g_results_per_core[core_id].results.push_back(TaskResult{task.task_id, task.start, task.end, core_id, std::move(primes)});
 
@@ -136,10 +150,34 @@ void initTaskQueue(int num_tasks, int chunk_size, int num_cores) {
     std::cout << "========================================\n" << std::endl;
 }
 
-// 输出计算结果到CSV文件函数 - 使用POSIX I/O避免Seastar内存分配限制
-seastar::future<> outputResults(const std::string& filename, int num_cores) {
+// 输出计算结果到文件函数（CSV 或二进制） - 使用POSIX I/O避免Seastar内存分配限制
+seastar::future<> outputResults(const std::string& filename, prime_output::Format format,
+                                prime_output::OutputMode mode, int num_cores) {
     std::cout << "\n正在写入结果文件: " << filename << std::endl;
 
+    // 流式：结果已在计算中写出，等待窗口内剩余任务落盘
+    if (mode == prime_output::OutputMode::stream) {
+        return g_stream->close().then([] {
+            std::cout << "重排缓冲峰值: " << g_stream->peak_pending() << " 个任务" << std::endl;
+            g_stream.reset();
+        });
+    }
+
+    // 多写者：各核在本地按任务ID排序、编码并按偏移写出
+    if (mode == prime_output::OutputMode::sharded) {
+        return prime_seastar_output::write_sharded(filename, format, [](prime_seastar_output::ShardBuffer& buf) {
+            auto& local = g_results_per_core[seastar::this_shard_id()].results;
+            std::sort(local.begin(), local.end(),
+                      [](const TaskResult& a, const TaskResult& b) {
+                          return a.task_id < b.task_id;
+                      });
+            for (const auto& r : local) {
+                buf.add(r.start, r.end, r.core_id, r.primes);
+            }
+            local.clear();
+        });
+    }
+
     // C2: 合并 per-core 结果
     std::vector<TaskResult> all_results;
     {
@@ -158,35 +196,19 @@ seastar::future<> outputResults(const std::string& filename, int num_cores) {
                   return a.task_id < b.task_id;
               });
 
-    return seastar::async([filename, results = std::move(all_results)]() mutable {
+    return seastar::async([filename, format, results = std::move(all_results)]() mutable {
         auto f = seastar::open_file_dma(filename,
             seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
-        seastar::file_output_stream_options opts;
-        opts.buffer_size = 4 * 1024 * 1024;
-        auto out = seastar::make_file_output_stream(std::move(f), opts).get();
-        char tmp[21];
-        std::string line;
-        line.reserve(128 * 1024);
+        // 行直接格式化进 DMA 缓冲，写满一块才提交一次
+        prime_seastar_output::DmaSink sink(std::move(f));
+        std::string header;
+        prime_output::append_file_header(format, header);
+        sink.write(header.data(), header.size());
         for (const auto& r : results) {
-            line.clear();
-            auto append_u64 = [&](uint64_t v) {
-                char* end = util::fast_uint64_to_str(v, tmp);
-                line.append(tmp, end - tmp);
-            };
-            append_u64(r.start);
-            line.push_back('-');
-            append_u64(r.end);
-            line.push_back(',');
-            append_u64(static_cast<uint64_t>(r.core_id));
-            for (uint64_t prime : r.primes) {
-                line.push_back(',');
-                append_u64(prime);
-            }
-            line.push_back('\n');
-            out.write(line.data(), line.size()).get();
+            sink.append_task(format, r.start, r.end, r.core_id, r.primes);
         }
-        out.flush().get();
-        out.close().get();
+        sink.close();
+        prime_seastar_output::write_index(filename, format, sink.index());
     });
 }
 
@@ -213,7 +235,7 @@ void printStatistics(long duration_ms) {
 }
 
 // Seastar应用主函数
-seastar::future<> seastar_main(const po::variables_map& config) {
+seastar::future<int> seastar_main(const po::variables_map& config) {
     // 设置日志级别 - 默认error
     applog.set_level(seastar::log_level::error);
 
@@ -240,44 +262,78 @@ seastar::future<> seastar_main(const po::variables_map& config) {
     if (config.count("output")) {
         output_file = config["output"].as<std::string>();
     }
+    prime_output::Format format = prime_output::Format::csv;
+    if (!prime_output::parse_format(config["format"].as<std::string>(), format)) {
+        std::cerr << "错误: 无效的输出格式 " << config["format"].as<std::string>() << " (可选: csv, bin, bitmap)" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
+    if (config["output"].defaulted()) {
+        output_file = prime_output::with_extension(output_file, format);
+    }
+    prime_output::OutputMode mode = prime_output::OutputMode::sharded;
+    if (!prime_output::parse_output_mode(config["output-mode"].as<std::string>(), mode) ||
+        mode == prime_output::OutputMode::mmap) {
+        std::cerr << "错误: 无效的输出模式 " << config["output-mode"].as<std::string>() << " (可选: sharded, single, stream)" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
+    const std::string cache_dir = config["cache-dir"].as<std::string>();
+    if (!cache_dir.empty()) {
+        g_cache = std::make_unique<prime_cache::Cache>();
+        if (!g_cache->open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << g_cache->error() << std::endl;
+            return seastar::make_ready_future<int>(1);
+        }
+        prime_cache::install(g_cache.get());
+    }
+    if (format == prime_output::Format::bitmap && !prime_output::bitmap_compatible(g_chunk_size)) {
+        std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+        return seastar::make_ready_future<int>(1);
+    }
 
     // 调用函数初始化任务队列
     initTaskQueue(g_num_tasks, g_chunk_size, g_num_cores);
 
+    // stream 模式：先打开有序写出端，worker 算完即可提交
+    auto opened = seastar::make_ready_future<>();
+    if (mode == prime_output::OutputMode::stream) {
+        g_stream = std::make_unique<prime_seastar_output::OrderedStream>();
+        opened = g_stream->open(output_file, format, prime_output::default_reorder_window(g_num_cores));
+    }
+
     // 记录开始时间
     auto start_time = std::chrono::high_resolution_clock::now();
 
     std::cout << "开始并行计算...\n" << std::endl;
     std::cout << std::flush;
 
-    // 创建所有核心的任务future - 使用submit_to提交到各核心
-    // 使用when_all等待所有核心完成任务
-    std::vector<seastar::future<>> all_futures;
-    all_futures.reserve(g_num_cores);
-
-    for (int i = 0; i < g_num_cores; ++i) {
-        // 使用submit_to将任务提交到指定核心
-        all_futures.push_back(seastar::smp::submit_to(i, [i]() {
-            return workerCoreLoop(i);
-        }));
-    }
-
     // 使用when_all_succeed等待所有任务完成，然后使用.then()链处理后续操作
-    return seastar::when_all_succeed(all_futures.begin(), all_futures.end()).then(
-        [start_time, output_file]() {
+    return opened.then([] {
+        // 创建所有核心的任务future - 使用submit_to提交到各核心
+        std::vector<seastar::future<>> all_futures;
+        all_futures.reserve(g_num_cores);
+
+        for (int i = 0; i < g_num_cores; ++i) {
+            // 使用submit_to将任务提交到指定核心
+            all_futures.push_back(seastar::smp::submit_to(i, [i]() {
+                return workerCoreLoop(i);
+            }));
+        }
+        return seastar::when_all_succeed(all_futures.begin(), all_futures.end());
+    }).then(
+        [start_time, output_file, format, mode]() {
             std::cout << std::endl;
 
             // 记录结束时间
             auto end_time = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-            // 调用函数输出结果到CSV文件（异步I/O）
-            return outputResults(output_file, g_num_cores).then([duration, start_time]() {
+            // 调用函数输出结果到文件（异步I/O）
+            return outputResults(output_file, format, mode, g_num_cores).then([duration, start_time]() {
                 // 打印统计结果
                 printStatistics(duration.count());
                 return seastar::make_ready_future<>();
             });
-        });
+        }).then([] { return 0; });
 }
 
 int main(int argc, char** argv) {
@@ -287,10 +343,19 @@ int main(int argc, char** argv) {
     app.add_options()
         ("tasks,t", po::value<int>()->default_value(20), "任务总数")
         ("chunk,n", po::value<int>()->default_value(100000), "每个任务的区间大小")
-        ("output,o", po::value<std::string>()->default_value("minimax_seastar_prime.csv"), "输出CSV文件路径")
+        ("output,o", po::value<std::string>()->default_value("minimax_seastar_prime.csv"), "输出文件路径 (bin/bitmap 格式默认 .bin/.bitmap)")
+        ("format,f", po::value<std::string>()->default_value("csv"), "输出格式 (csv/bin/bitmap)")
+        ("output-mode", po::value<std::string>()->default_value("sharded"), "写出方式 (sharded: 各核按偏移并行写; single: 合并到核 0 顺序写; stream: 计算中按任务ID有序写出)")
+        ("cache-dir", po::value<std::string>()->default_value(""), "持久素数缓存目录：已缓存的区间直接 mmap 读取，其余筛完后写入 (默认不启用)")
         ("log-level,l", po::value<std::string>(), "日志级别 (debug/info/error/trace)");
 
     return app.run(argc, argv, [&app] {
-        return seastar_main(app.configuration());
+        return seastar_main(app.configuration()).then([](int status) {
+            if (status == 0 && g_cache) {
+                std::cout << "素数缓存: 命中 " << g_cache->hits() << " 块, 新筛 " << g_cache->misses()
+                          << " 块 (" << g_cache->dir() << ")" << std::endl;
+            }
+            return status;
+        });
     });
 }
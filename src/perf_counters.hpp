@@ -0,0 +1,177 @@
+#pragma once
+// Hardware/software performance counters via perf_event_open(2).
+// Each event is opened as an independent counter on the calling process with
+// inherit=1, so threads spawned during the measured region and child
+// processes forked and reaped inside it are folded into the totals. Grouped
+// reads are not used because PERF_FORMAT_GROUP cannot be combined with
+// inherit on older kernels; multiplexed counters are scaled by
+// time_enabled / time_running instead.
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace perf {
+
+enum Event : size_t {
+    cycles = 0,
+    instructions,
+    l1d_misses,
+    llc_misses,
+    branch_misses,
+    context_switches,
+    cpu_migrations,
+    kEventCount
+};
+
+inline const char* event_name(size_t e) {
+    static constexpr const char* names[kEventCount] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses",
+        "branch_misses", "context_switches", "cpu_migrations",
+    };
+    return e < kEventCount ? names[e] : "unknown";
+}
+
+// 一次测量的计数结果；valid[e] 为 false 表示该事件不可用（权限、虚拟机无 PMU 等）
+struct Sample {
+    std::array<uint64_t, kEventCount> value{};
+    std::array<bool, kEventCount> valid{};
+
+    bool has(size_t e) const { return valid[e]; }
+
+    // 每周期指令数
+    double ipc() const {
+        if (!has(cycles) || !has(instructions) || value[cycles] == 0) return 0.0;
+        return static_cast<double>(value[instructions]) / static_cast<double>(value[cycles]);
+    }
+
+    // 每百万个被筛数的事件数
+    double per_million(size_t e, uint64_t numbers) const {
+        if (!has(e) || numbers == 0) return 0.0;
+        return static_cast<double>(value[e]) * 1e6 / static_cast<double>(numbers);
+    }
+};
+
+class Counters {
+public:
+    Counters() { fds_.fill(-1); }
+    ~Counters() { close_all(); }
+    Counters(const Counters&) = delete;
+    Counters& operator=(const Counters&) = delete;
+
+    // 打开全部计数器，返回成功打开的个数
+    size_t open() {
+        close_all();
+        size_t opened = 0;
+        for (size_t e = 0; e < kEventCount; ++e) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            describe(e, attr);
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            // 软件事件（上下文切换、迁移）发生在内核态
+            if (attr.type == PERF_TYPE_SOFTWARE) attr.exclude_kernel = 0;
+            long fd = syscall(SYS_perf_event_open, &attr, 0 /* self */, -1 /* any cpu */, -1, 0);
+            if (fd < 0 && attr.exclude_kernel == 0) {
+                // perf_event_paranoid >= 2 时不允许统计内核态，退回只统计用户态
+                attr.exclude_kernel = 1;
+                fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            }
+            fds_[e] = static_cast<int>(fd);
+            if (fd >= 0) ++opened;
+        }
+        return opened;
+    }
+
+    bool any_open() const {
+        for (int fd : fds_) {
+            if (fd >= 0) return true;
+        }
+        return false;
+    }
+
+    void start() {
+        for (int fd : fds_) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    Sample stop() {
+        Sample s;
+        for (size_t e = 0; e < kEventCount; ++e) {
+            int fd = fds_[e];
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t buf[3] = {};
+            if (::read(fd, buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) continue;
+            uint64_t value = buf[0], enabled = buf[1], running = buf[2];
+            if (running == 0) continue;
+            if (running < enabled) {
+                value = static_cast<uint64_t>(static_cast<double>(value) * enabled / running);
+            }
+            s.value[e] = value;
+            s.valid[e] = true;
+        }
+        return s;
+    }
+
+private:
+    static void describe(size_t e, perf_event_attr& attr) {
+        switch (e) {
+            case cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case l1d_misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D
+                            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case llc_misses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            case branch_misses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case context_switches:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+                break;
+            case cpu_migrations:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_CPU_MIGRATIONS;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void close_all() {
+        for (int& fd : fds_) {
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+        }
+    }
+
+    std::array<int, kEventCount> fds_;
+};
+
+} // namespace perf
@@ -1,12 +1,18 @@
 // prime_bench: 素数计算性能基准测试
-// 依次调用外部程序：sequence、minimax_libfork、glm5_libfork、minimax_seastar、sonnet46_seastar、kimi_seastar
-// 使用 fork+execvp 替代 popen，避免 shell 注入
+// sequence / libfork 调度策略在进程内运行（prime_harness.hpp），分阶段计时：计算、合并、排序、写入
+// Seastar 程序独占 reactor 与内存，仍以子进程方式运行：fork+execvp 替代 popen，避免 shell 注入
+// --warmup K 次预热（丢弃）+ --repeat N 次采样，各框架轮流交错运行以分摊系统漂移
+// --json / --csv 输出机器可读结果；--baseline + --max-regress 对比基线，退化时返回非零退出码
+// --perf 通过 perf_event_open 采集每次运行的硬件计数器（IPC、缓存/分支未命中、上下文切换、迁移）
+// --sweep-cores / --sweep-range 扫描核数或区间，输出加速比、并行效率与 Karp–Flatt 串行比例（绘图用长表 CSV）
 
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <chrono>
+#include <ctime>
 #include <iomanip>
 #include <algorithm>
 #include <cstdio>
@@ -15,28 +21,128 @@
 #include <cstring>
 #include <getopt.h>
 #include <sys/stat.h>
+#include <sys/utsname.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "bench_json.hpp"
+#include "bench_stats.hpp"
+#include "perf_counters.hpp"
+#include "prime_cache.hpp"
+#include "prime_harness.hpp"
+#include "prime_output.hpp"
+
 struct BenchmarkResult {
     std::string name;
+    bool in_process = false;      // 进程内运行（否则为子进程）
     size_t primes = 0;
-    long duration_ms = 0;
+    double duration_ms = 0.0;     // 总耗时（子进程为 fork 到 waitpid 的墙钟时间）
+    harness::PhaseTimes phases;   // 子进程只有 compute_ms（解析自"计算耗时"）
+    perf::Sample counters;        // 仅在 --perf 时有效
     int exit_status = 0;
 };
 
+// 一个被测框架的所有采样
+struct FrameworkResult {
+    std::string name;
+    bool in_process = false;
+    std::vector<BenchmarkResult> runs;   // 不含预热
+    size_t primes = 0;                   // 所有采样一致时的素数总数
+    bool primes_consistent = true;       // 各次采样素数总数是否一致
+    int failures = 0;                    // 异常退出次数
+    bench::Summary summary;              // 成功采样的总耗时统计
+
+    std::vector<double> samples() const {
+        std::vector<double> v;
+        for (const auto& r : runs) {
+            if (r.exit_status == 0) v.push_back(r.duration_ms);
+        }
+        return v;
+    }
+
+    // 各阶段中位数
+    harness::PhaseTimes medianPhases() const {
+        std::vector<double> c, m, s, w;
+        for (const auto& r : runs) {
+            if (r.exit_status != 0) continue;
+            c.push_back(r.phases.compute_ms);
+            m.push_back(r.phases.merge_ms);
+            s.push_back(r.phases.sort_ms);
+            w.push_back(r.phases.write_ms);
+        }
+        harness::PhaseTimes p;
+        p.compute_ms = bench::median_of(c);
+        p.merge_ms = bench::median_of(m);
+        p.sort_ms = bench::median_of(s);
+        p.write_ms = bench::median_of(w);
+        return p;
+    }
+
+    // 各计数器中位数（仅统计该事件有效的成功采样）
+    perf::Sample medianCounters() const {
+        perf::Sample m;
+        for (size_t e = 0; e < perf::kEventCount; ++e) {
+            std::vector<double> values;
+            for (const auto& r : runs) {
+                if (r.exit_status == 0 && r.counters.has(e)) {
+                    values.push_back(static_cast<double>(r.counters.value[e]));
+                }
+            }
+            if (values.empty()) continue;
+            m.value[e] = static_cast<uint64_t>(bench::median_of(std::move(values)));
+            m.valid[e] = true;
+        }
+        return m;
+    }
+
+    bool ok() const { return summary.n > 0 && failures == 0; }
+};
+
+// 被测目标：进程内策略或 Seastar 子进程
+struct BenchTarget {
+    std::string name;
+    std::string description;
+    bool in_process = false;
+    harness::Strategy strategy = harness::Strategy::sequence;
+    std::vector<std::string> args;   // 子进程参数
+};
+
+// 从子进程输出中解析 "<key>: <数字>" 行
+static bool parseOutputField(const std::string& output, const std::string& key, uint64_t& value) {
+    std::istringstream iss(output);
+    std::string line;
+    while (std::getline(iss, line)) {
+        size_t key_pos = line.find(key);
+        if (key_pos == std::string::npos) continue;
+        size_t pos = line.find(":", key_pos);
+        if (pos == std::string::npos) continue;
+        std::string num_str = line.substr(pos + 1);
+        num_str.erase(std::remove_if(num_str.begin(), num_str.end(),
+            [](unsigned char c) { return !std::isdigit(c); }), num_str.end());
+        try {
+            value = std::stoull(num_str);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return false;
+}
+
 static bool isProgramNameSafe(const std::string& program) {
     return !program.empty() &&
            std::all_of(program.begin(), program.end(),
                [](unsigned char c) { return std::isalnum(c) || c == '_' || c == '-'; });
 }
 
-static BenchmarkResult runProgram(const std::string& program, const std::vector<std::string>& args) {
+static BenchmarkResult runProgram(const std::string& program, const std::vector<std::string>& args,
+                                  bool collect_perf) {
     BenchmarkResult result;
     result.name = program;
 
     if (!isProgramNameSafe(program)) {
         std::cerr << "错误: 非法程序名 " << program << std::endl;
+        result.exit_status = -1;
         return result;
     }
 
@@ -52,16 +158,25 @@ static BenchmarkResult runProgram(const std::string& program, const std::vector<
     int pipefd[2];
     if (pipe(pipefd) == -1) {
         std::cerr << "错误: pipe 创建失败 for " << program << std::endl;
+        result.exit_status = -1;
         return result;
     }
 
-    auto start_time = std::chrono::high_resolution_clock::now();
+    // 计数器 inherit=1：fork 出的子进程（含 exec 后的程序）在被 waitpid 回收时计入
+    perf::Counters counters;
+    if (collect_perf) {
+        counters.open();
+        counters.start();
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
 
     pid_t pid = fork();
     if (pid == -1) {
         close(pipefd[0]);
         close(pipefd[1]);
         std::cerr << "错误: fork 失败 for " << program << std::endl;
+        result.exit_status = -1;
         return result;
     }
 
@@ -81,6 +196,7 @@ static BenchmarkResult runProgram(const std::string& program, const std::vector<
         close(pipefd[0]);
         std::cerr << "错误: fdopen 失败 for " << program << std::endl;
         waitpid(pid, nullptr, 0);
+        result.exit_status = -1;
         return result;
     }
 
@@ -94,8 +210,12 @@ static BenchmarkResult runProgram(const std::string& program, const std::vector<
     int status;
     waitpid(pid, &status, 0);
 
-    auto end_time = std::chrono::high_resolution_clock::now();
-    result.duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+    if (collect_perf) {
+        result.counters = counters.stop();
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    result.duration_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
 
     if (WIFEXITED(status)) {
         result.exit_status = WEXITSTATUS(status);
@@ -109,58 +229,150 @@ static BenchmarkResult runProgram(const std::string& program, const std::vector<
         return result;
     }
 
-    if (output.find("素数总数") == std::string::npos) {
+    uint64_t primes = 0;
+    if (parseOutputField(output, "素数总数:", primes)) {
+        result.primes = primes;
+    } else {
         std::cerr << "警告: " << program << " 输出中未找到'素数总数'" << std::endl;
         std::cerr << "前200字符输出: " << output.substr(0, 200) << std::endl;
     }
 
-    std::istringstream iss(output);
-    std::string line;
-    while (std::getline(iss, line)) {
-        if (line.find("素数总数:") != std::string::npos) {
-            size_t pos = line.find(":");
-            if (pos != std::string::npos) {
-                std::string num_str = line.substr(pos + 1);
-                num_str.erase(std::remove_if(num_str.begin(), num_str.end(),
-                    [](unsigned char c) { return std::isspace(c); }), num_str.end());
-                try {
-                    result.primes = std::stoull(num_str);
-                } catch (const std::exception& e) {
-                    std::cerr << "错误: 无法解析素数总数 '" << num_str << "' from " << program << std::endl;
-                }
-                break;
-            }
-        }
+    uint64_t compute_ms = 0;
+    if (parseOutputField(output, "计算耗时:", compute_ms)) {
+        result.phases.compute_ms = static_cast<double>(compute_ms);
     }
 
     return result;
 }
 
-static void printSeparator(char c = '=', int width = 60) {
+// 进程内运行调度策略，结果写入 ./output/<name>.csv（bin 格式为 .bin）
+static BenchmarkResult runInProcess(const std::string& name, harness::Strategy strategy,
+                                    int num_tasks, int chunk_size, int num_threads,
+                                    prime_output::Format format, bool collect_perf) {
+    BenchmarkResult result;
+    result.name = name;
+    result.in_process = true;
+
+    harness::RunConfig config;
+    config.num_tasks = num_tasks;
+    config.chunk_size = chunk_size;
+    config.num_threads = num_threads;
+    config.output_file = prime_output::with_extension("./output/" + name + ".csv", format);
+    config.format = format;
+
+    // 计数器 inherit=1：线程池在运行期间创建的工作线程一并计入
+    perf::Counters counters;
+    if (collect_perf) {
+        counters.open();
+        counters.start();
+    }
+    auto run = harness::run(strategy, config);
+    if (collect_perf) {
+        result.counters = counters.stop();
+    }
+    result.primes = run.primes;
+    result.phases = run.phases;
+    result.duration_ms = run.phases.total_ms();
+    if (!run.ok()) {
+        // 写入失败的样本不计入统计
+        std::cerr << "警告: " << name << " 写入结果失败: " << run.error << std::endl;
+        result.exit_status = -1;
+    }
+    return result;
+}
+
+static void printSeparator(char c = '=', int width = 100) {
     std::cout << std::string(width, c) << std::endl;
 }
 
-static void printResults(const std::vector<BenchmarkResult>& results) {
+static std::string formatMs(double ms, int precision = 1) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(precision) << ms;
+    return oss.str();
+}
+
+static void finalizeResult(FrameworkResult& fr) {
+    fr.failures = 0;
+    bool first = true;
+    for (const auto& r : fr.runs) {
+        if (r.exit_status != 0) {
+            ++fr.failures;
+            continue;
+        }
+        if (first) {
+            fr.primes = r.primes;
+            first = false;
+        } else if (r.primes != fr.primes) {
+            fr.primes_consistent = false;
+        }
+    }
+    fr.summary = bench::summarize(fr.samples());
+}
+
+// 打印结果表，返回结果一致性
+static bool printResults(const std::vector<FrameworkResult>& results) {
     printSeparator();
     std::cout << "性能比较结果" << std::endl;
     printSeparator();
 
+    // 阶段列：进程内运行分别计时；子进程只有自报的计算耗时，
+    // "其他" = 总耗时 - 各阶段之和（子进程即进程启动、Seastar 初始化、合并/排序/写入、管道捕获）
+    // 阶段列与总耗时均为各次采样的中位数
     std::cout << std::left << std::setw(24) << "框架"
-              << std::right << std::setw(18) << "素数总数"
+              << std::left << std::setw(8) << "模式"
+              << std::right << std::setw(12) << "素数总数"
+              << std::right << std::setw(10) << "计算"
+              << std::right << std::setw(10) << "合并"
+              << std::right << std::setw(10) << "排序"
+              << std::right << std::setw(10) << "写入"
+              << std::right << std::setw(10) << "其他"
               << std::right << std::setw(12) << "耗时(ms)" << std::endl;
     printSeparator('-');
 
-    for (const auto& r : results) {
-        std::cout << std::left << std::setw(24) << r.name
-                  << std::right << std::setw(18) << r.primes
-                  << std::right << std::setw(12) << r.duration_ms << std::endl;
+    for (const auto& fr : results) {
+        auto phases = fr.medianPhases();
+        double other_ms = std::max(0.0, fr.summary.median - phases.total_ms());
+        auto phase_cell = [&](double ms) { return fr.in_process ? formatMs(ms) : std::string("-"); };
+        std::cout << std::left << std::setw(24) << fr.name
+                  << std::left << std::setw(8) << (fr.in_process ? "进程内" : "子进程")
+                  << std::right << std::setw(12) << fr.primes
+                  << std::right << std::setw(10) << formatMs(phases.compute_ms)
+                  << std::right << std::setw(10) << phase_cell(phases.merge_ms)
+                  << std::right << std::setw(10) << phase_cell(phases.sort_ms)
+                  << std::right << std::setw(10) << phase_cell(phases.write_ms)
+                  << std::right << std::setw(10) << formatMs(other_ms)
+                  << std::right << std::setw(12) << formatMs(fr.summary.median) << std::endl;
+    }
+    printSeparator('-');
+
+    // 采样分布：min / median / p95 / stddev / 中位数 95% bootstrap 置信区间
+    std::cout << std::left << std::setw(24) << "框架"
+              << std::right << std::setw(6) << "n"
+              << std::right << std::setw(10) << "min"
+              << std::right << std::setw(10) << "median"
+              << std::right << std::setw(10) << "p95"
+              << std::right << std::setw(10) << "stddev"
+              << std::right << std::setw(24) << "median 95% CI"
+              << std::right << std::setw(8) << "失败" << std::endl;
+    printSeparator('-');
+    for (const auto& fr : results) {
+        const auto& s = fr.summary;
+        std::cout << std::left << std::setw(24) << fr.name
+                  << std::right << std::setw(6) << s.n
+                  << std::right << std::setw(10) << formatMs(s.min)
+                  << std::right << std::setw(10) << formatMs(s.median)
+                  << std::right << std::setw(10) << formatMs(s.p95)
+                  << std::right << std::setw(10) << formatMs(s.stddev, 2)
+                  << std::right << std::setw(24)
+                  << ("[" + formatMs(s.ci_low) + ", " + formatMs(s.ci_high) + "]")
+                  << std::right << std::setw(8) << fr.failures << std::endl;
     }
     printSeparator('-');
 
     bool all_consistent = true;
     size_t expected_primes = results[0].primes;
-    for (size_t i = 1; i < results.size(); ++i) {
-        if (results[i].primes != expected_primes) {
+    for (const auto& fr : results) {
+        if (!fr.primes_consistent || fr.failures > 0 || fr.primes != expected_primes) {
             all_consistent = false;
             break;
         }
@@ -169,69 +381,829 @@ static void printResults(const std::vector<BenchmarkResult>& results) {
     std::cout << "结果一致性: " << (all_consistent ? "✓ 通过" : "✗ 失败") << std::endl;
     printSeparator();
 
-    const BenchmarkResult* seq_result = nullptr;
-    for (const auto& r : results) {
-        if (r.name == "sequence_prime") {
-            seq_result = &r;
+    const FrameworkResult* seq_result = nullptr;
+    for (const auto& fr : results) {
+        if (fr.name == "sequence_prime") {
+            seq_result = &fr;
             break;
         }
     }
 
-    if (seq_result && seq_result->duration_ms > 0) {
-        std::cout << "\n加速比（以sequence为基准）:" << std::endl;
-        for (const auto& r : results) {
-            if (r.name != "sequence_prime" && r.duration_ms > 0) {
-                double speedup = static_cast<double>(seq_result->duration_ms) / r.duration_ms;
-                std::cout << "  " << std::left << std::setw(20) << r.name
-                          << ": " << std::fixed << std::setprecision(2) << speedup << "x" << std::endl;
+    // 加速比 = median(sequence) / median(框架)；显著性基于中位数之比的 bootstrap 置信区间
+    if (seq_result && seq_result->ok() && seq_result->summary.median > 0) {
+        auto seq_samples = seq_result->samples();
+        std::cout << "\n加速比（以sequence为基准，中位数）:" << std::endl;
+        for (const auto& fr : results) {
+            if (fr.name == "sequence_prime" || !fr.ok() || fr.summary.median <= 0) continue;
+            auto cmp = bench::compare(fr.samples(), seq_samples);
+            double speedup = seq_result->summary.median / fr.summary.median;
+            std::cout << "  " << std::left << std::setw(24) << fr.name
+                      << ": " << std::fixed << std::setprecision(2) << speedup << "x";
+            if (cmp.verdict != bench::Verdict::insufficient) {
+                std::cout << "  [" << std::setprecision(2) << 1.0 / cmp.ci_high
+                          << "x, " << 1.0 / cmp.ci_low << "x]";
             }
+            std::cout << "  " << bench::verdict_label(cmp.verdict) << std::endl;
         }
     }
 
-    if (!results.empty()) {
-        auto fastest = std::min_element(results.begin(), results.end(),
-            [](const BenchmarkResult& a, const BenchmarkResult& b) {
-                return a.duration_ms > 0 && b.duration_ms > 0 && a.duration_ms < b.duration_ms;
-            });
-        if (fastest != results.end() && fastest->duration_ms > 0) {
-            std::cout << "\n最快框架: " << fastest->name
-                      << " (" << fastest->duration_ms << "ms)" << std::endl;
+    // 最快框架，并与次快框架做显著性比较
+    std::vector<const FrameworkResult*> ranked;
+    for (const auto& fr : results) {
+        if (fr.ok() && fr.summary.median > 0) ranked.push_back(&fr);
+    }
+    std::sort(ranked.begin(), ranked.end(),
+        [](const FrameworkResult* a, const FrameworkResult* b) {
+            return a->summary.median < b->summary.median;
+        });
+    if (!ranked.empty()) {
+        const auto* fastest = ranked[0];
+        std::cout << "\n最快框架: " << fastest->name
+                  << " (" << formatMs(fastest->summary.median) << "ms)" << std::endl;
+        if (ranked.size() > 1) {
+            const auto* second = ranked[1];
+            auto cmp = bench::compare(fastest->samples(), second->samples());
+            std::cout << "对比次快 " << second->name << " (" << formatMs(second->summary.median)
+                      << "ms): " << bench::verdict_label(cmp.verdict);
+            if (cmp.verdict != bench::Verdict::insufficient) {
+                std::cout << "，耗时比 " << std::fixed << std::setprecision(3) << cmp.ratio
+                          << " [" << cmp.ci_low << ", " << cmp.ci_high << "]";
+            }
+            std::cout << std::endl;
         }
     }
 
     printSeparator();
+    return all_consistent;
+}
+
+// 硬件计数器表：耗时旁给出 IPC 与每百万被筛数的未命中次数，用于区分访存瓶颈与计算瓶颈
+static void printPerfCounters(const std::vector<FrameworkResult>& results, uint64_t numbers) {
+    printSeparator();
+    std::cout << "硬件计数器 (各次采样中位数，未命中按每百万被筛数计)" << std::endl;
+    printSeparator();
+    // 中文表头按 UTF-8 字节数补宽，保证与数据列对齐
+    std::cout << std::left << std::setw(26) << "框架"
+              << std::right << std::setw(12) << "耗时(ms)"
+              << std::right << std::setw(8) << "IPC"
+              << std::right << std::setw(12) << "L1D miss/M"
+              << std::right << std::setw(12) << "LLC miss/M"
+              << std::right << std::setw(14) << "分支miss/M"
+              << std::right << std::setw(17) << "上下文切换"
+              << std::right << std::setw(12) << "CPU迁移" << std::endl;
+    printSeparator('-');
+
+    auto cell = [](const perf::Sample& c, size_t e, double v, int precision) {
+        return c.has(e) ? formatMs(v, precision) : std::string("n/a");
+    };
+    for (const auto& fr : results) {
+        auto c = fr.medianCounters();
+        bool has_ipc = c.has(perf::cycles) && c.has(perf::instructions);
+        std::cout << std::left << std::setw(24) << fr.name
+                  << std::right << std::setw(10) << formatMs(fr.summary.median)
+                  << std::right << std::setw(8) << (has_ipc ? formatMs(c.ipc(), 2) : std::string("n/a"))
+                  << std::right << std::setw(12) << cell(c, perf::l1d_misses, c.per_million(perf::l1d_misses, numbers), 0)
+                  << std::right << std::setw(12) << cell(c, perf::llc_misses, c.per_million(perf::llc_misses, numbers), 0)
+                  << std::right << std::setw(12) << cell(c, perf::branch_misses, c.per_million(perf::branch_misses, numbers), 0)
+                  << std::right << std::setw(12) << cell(c, perf::context_switches, static_cast<double>(c.value[perf::context_switches]), 0)
+                  << std::right << std::setw(10) << cell(c, perf::cpu_migrations, static_cast<double>(c.value[perf::cpu_migrations]), 0)
+                  << std::endl;
+    }
+    printSeparator();
+}
+
+static json::Value countersToJson(const perf::Sample& c, uint64_t numbers) {
+    json::Value v = json::Value::object();
+    for (size_t e = 0; e < perf::kEventCount; ++e) {
+        if (c.has(e)) v[perf::event_name(e)] = c.value[e];
+    }
+    if (c.has(perf::cycles) && c.has(perf::instructions)) v["ipc"] = c.ipc();
+    if (c.has(perf::l1d_misses)) v["l1d_misses_per_million"] = c.per_million(perf::l1d_misses, numbers);
+    if (c.has(perf::llc_misses)) v["llc_misses_per_million"] = c.per_million(perf::llc_misses, numbers);
+    if (c.has(perf::branch_misses)) v["branch_misses_per_million"] = c.per_million(perf::branch_misses, numbers);
+    return v;
+}
+
+// 基准配置（写入 JSON，并用于与基线核对）
+struct BenchConfig {
+    int num_tasks = 32;
+    int chunk_size = 100000;
+    int num_threads = 32;
+    int repeat = 1;
+    int warmup = 0;
+    bool perf = false;
+    prime_output::Format format = prime_output::Format::csv;
+
+    uint64_t numbers() const { return static_cast<uint64_t>(num_tasks) * chunk_size; }
+};
+
+static std::string readFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// 当前提交：直接读取 .git/HEAD，避免启动子进程
+static std::string gitCommit() {
+    std::string head = readFirstLine(".git/HEAD");
+    const std::string ref_prefix = "ref: ";
+    if (head.rfind(ref_prefix, 0) != 0) return head;
+    std::string ref = head.substr(ref_prefix.size());
+    std::string commit = readFirstLine(".git/" + ref);
+    if (!commit.empty()) return commit;
+    std::ifstream packed(".git/packed-refs");
+    std::string line;
+    while (std::getline(packed, line)) {
+        if (line.size() > 41 && line.compare(41, std::string::npos, ref) == 0) {
+            return line.substr(0, 40);
+        }
+    }
+    return "";
+}
+
+static json::Value hostInfo() {
+    json::Value host = json::Value::object();
+
+    char hostname[256] = {};
+    if (gethostname(hostname, sizeof(hostname) - 1) == 0) host["hostname"] = hostname;
+
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        host["kernel"] = std::string(uts.sysname) + " " + uts.release;
+        host["arch"] = uts.machine;
+    }
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            size_t pos = line.find(':');
+            if (pos != std::string::npos) {
+                host["cpu_model"] = line.substr(line.find_first_not_of(' ', pos + 1));
+            }
+            break;
+        }
+    }
+    host["online_cpus"] = sysconf(_SC_NPROCESSORS_ONLN);
+
+    std::time_t now = std::time(nullptr);
+    char ts[32];
+    std::strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    host["timestamp"] = ts;
+
+    std::string commit = gitCommit();
+    if (!commit.empty()) host["git_commit"] = commit;
+    return host;
+}
+
+static json::Value summaryToJson(const bench::Summary& s) {
+    json::Value v = json::Value::object();
+    v["n"] = s.n;
+    v["min_ms"] = s.min;
+    v["median_ms"] = s.median;
+    v["p95_ms"] = s.p95;
+    v["mean_ms"] = s.mean;
+    v["stddev_ms"] = s.stddev;
+    v["ci95_low_ms"] = s.ci_low;
+    v["ci95_high_ms"] = s.ci_high;
+    return v;
+}
+
+static json::Value resultsToJson(const BenchConfig& cfg, const std::vector<FrameworkResult>& results,
+                                 bool all_consistent) {
+    json::Value root = json::Value::object();
+    root["schema"] = 1;
+
+    json::Value& config = root["config"];
+    config["tasks"] = cfg.num_tasks;
+    config["chunk"] = cfg.chunk_size;
+    config["threads"] = cfg.num_threads;
+    config["range_end"] = static_cast<uint64_t>(cfg.num_tasks) * cfg.chunk_size;
+    config["repeat"] = cfg.repeat;
+    config["warmup"] = cfg.warmup;
+    config["perf"] = cfg.perf;
+    config["format"] = prime_output::format_name(cfg.format);
+
+    root["host"] = hostInfo();
+    root["consistent"] = all_consistent;
+
+    json::Value frameworks = json::Value::array();
+    for (const auto& fr : results) {
+        json::Value f = json::Value::object();
+        f["name"] = fr.name;
+        f["mode"] = fr.in_process ? "in_process" : "child";
+        f["primes"] = fr.primes;
+        f["primes_consistent"] = fr.primes_consistent;
+        f["failures"] = fr.failures;
+        f["summary"] = summaryToJson(fr.summary);
+        if (cfg.perf) f["perf_median"] = countersToJson(fr.medianCounters(), cfg.numbers());
+        json::Value runs = json::Value::array();
+        for (const auto& r : fr.runs) {
+            json::Value run = json::Value::object();
+            run["exit_status"] = r.exit_status;
+            run["primes"] = r.primes;
+            run["duration_ms"] = r.duration_ms;
+            run["compute_ms"] = r.phases.compute_ms;
+            if (fr.in_process) {
+                run["merge_ms"] = r.phases.merge_ms;
+                run["sort_ms"] = r.phases.sort_ms;
+                run["write_ms"] = r.phases.write_ms;
+            }
+            if (cfg.perf) run["perf"] = countersToJson(r.counters, cfg.numbers());
+            runs.push_back(std::move(run));
+        }
+        f["runs"] = std::move(runs);
+        frameworks.push_back(std::move(f));
+    }
+    root["frameworks"] = std::move(frameworks);
+    return root;
+}
+
+static bool writeTextFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "错误: 无法写入 " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    out << content;
+    out.flush();
+    if (!out) {
+        std::cerr << "错误: 写入 " << path << " 失败: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 每次采样一行，便于表格工具直接导入
+static std::string resultsToCsv(const std::vector<FrameworkResult>& results) {
+    std::ostringstream oss;
+    oss << "framework,mode,run,exit_status,primes,duration_ms,compute_ms,merge_ms,sort_ms,write_ms";
+    for (size_t e = 0; e < perf::kEventCount; ++e) oss << ',' << perf::event_name(e);
+    oss << '\n';
+    oss << std::fixed << std::setprecision(3);
+    for (const auto& fr : results) {
+        for (size_t i = 0; i < fr.runs.size(); ++i) {
+            const auto& r = fr.runs[i];
+            oss << fr.name << ',' << (fr.in_process ? "in_process" : "child") << ','
+                << i << ',' << r.exit_status << ',' << r.primes << ','
+                << r.duration_ms << ',' << r.phases.compute_ms << ',';
+            if (fr.in_process) {
+                oss << r.phases.merge_ms << ',' << r.phases.sort_ms << ',' << r.phases.write_ms;
+            } else {
+                oss << ",,";
+            }
+            for (size_t e = 0; e < perf::kEventCount; ++e) {
+                oss << ',';
+                if (r.counters.has(e)) oss << r.counters.value[e];
+            }
+            oss << '\n';
+        }
+    }
+    return oss.str();
+}
+
+// 与基线 JSON 对比：中位数退化超过阈值，且（双方采样足够时）bootstrap 判定显著更慢，即视为退化。
+// 素数总数与基线不一致或本次运行失败同样判为不通过。
+static bool checkBaseline(const std::string& path, double max_regress_pct,
+                          const BenchConfig& cfg, const std::vector<FrameworkResult>& results) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "错误: 无法读取基线文件 " << path << std::endl;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string error;
+    auto baseline = json::parse(text, &error);
+    const json::Value* frameworks = baseline ? baseline->find("frameworks") : nullptr;
+    if (!frameworks || !frameworks->is_array()) {
+        std::cerr << "错误: 基线文件格式无效 " << path << (error.empty() ? "" : ": " + error) << std::endl;
+        return false;
+    }
+
+    if (const json::Value* config = baseline->find("config")) {
+        auto differs = [&](const char* key, int current) {
+            const json::Value* v = config->find(key);
+            return v && static_cast<int>(v->as_number()) != current;
+        };
+        if (differs("tasks", cfg.num_tasks) || differs("chunk", cfg.chunk_size) ||
+            differs("threads", cfg.num_threads)) {
+            std::cerr << "警告: 基线配置 (-t/-n/-c) 与本次运行不同，对比结果可能无意义" << std::endl;
+        }
+        const json::Value* base_format = config->find("format");
+        std::string current_format = prime_output::format_name(cfg.format);
+        if (base_format ? base_format->as_string() != current_format : current_format != "csv") {
+            std::cerr << "警告: 基线输出格式 (-f) 与本次运行不同，写入阶段耗时不可比" << std::endl;
+        }
+    }
+
+    printSeparator();
+    std::cout << "基线对比: " << path << " (允许退化 " << max_regress_pct << "%)" << std::endl;
+    printSeparator();
+    std::cout << std::left << std::setw(24) << "框架"
+              << std::right << std::setw(12) << "基线(ms)"
+              << std::right << std::setw(12) << "当前(ms)"
+              << std::right << std::setw(10) << "变化"
+              << "  结论" << std::endl;
+    printSeparator('-');
+
+    bool passed = true;
+    for (const auto& fr : results) {
+        const json::Value* base = nullptr;
+        for (const auto& item : frameworks->items()) {
+            const json::Value* name = item.find("name");
+            if (name && name->as_string() == fr.name) {
+                base = &item;
+                break;
+            }
+        }
+        std::cout << std::left << std::setw(24) << fr.name;
+        if (!base) {
+            std::cout << std::right << std::setw(12) << "-"
+                      << std::right << std::setw(12) << formatMs(fr.summary.median)
+                      << std::right << std::setw(10) << "-" << "  基线中不存在，跳过" << std::endl;
+            continue;
+        }
+
+        std::vector<double> base_samples;
+        if (const json::Value* runs = base->find("runs")) {
+            for (const auto& run : runs->items()) {
+                const json::Value* status = run.find("exit_status");
+                const json::Value* ms = run.find("duration_ms");
+                if (ms && (!status || status->as_number() == 0)) base_samples.push_back(ms->as_number());
+            }
+        }
+        double base_median = bench::median_of(base_samples);
+        if (const json::Value* summary = base->find("summary")) {
+            if (const json::Value* m = summary->find("median_ms")) base_median = m->as_number(base_median);
+        }
+
+        std::string verdict;
+        bool regressed = false;
+        double change_pct = 0.0;
+        const json::Value* base_primes = base->find("primes");
+        if (!fr.ok()) {
+            regressed = true;
+            verdict = "运行失败";
+        } else if (base_primes && static_cast<uint64_t>(base_primes->as_number()) != fr.primes) {
+            regressed = true;
+            verdict = "素数总数不一致 (基线 " +
+                      std::to_string(static_cast<uint64_t>(base_primes->as_number())) + ")";
+        } else if (base_median > 0) {
+            change_pct = (fr.summary.median / base_median - 1.0) * 100.0;
+            auto cmp = bench::compare(fr.samples(), base_samples);
+            bool significant = cmp.verdict == bench::Verdict::insufficient ||
+                               cmp.verdict == bench::Verdict::slower;
+            if (change_pct > max_regress_pct && significant) {
+                regressed = true;
+                verdict = "✗ 退化";
+            } else if (change_pct > max_regress_pct) {
+                verdict = "超出阈值但无显著差异";
+            } else {
+                verdict = "✓ 通过";
+            }
+            if (cmp.verdict != bench::Verdict::insufficient && cmp.verdict != bench::Verdict::indistinct) {
+                verdict += std::string(" (") + bench::verdict_label(cmp.verdict) + ")";
+            }
+        } else {
+            verdict = "基线耗时无效，跳过";
+        }
+
+        if (regressed) passed = false;
+        std::ostringstream change;
+        change << std::showpos << std::fixed << std::setprecision(1) << change_pct << "%";
+        std::cout << std::right << std::setw(12) << formatMs(base_median)
+                  << std::right << std::setw(12) << formatMs(fr.summary.median)
+                  << std::right << std::setw(10) << change.str()
+                  << "  " << verdict << std::endl;
+    }
+    printSeparator('-');
+    std::cout << "基线检查: " << (passed ? "✓ 通过" : "✗ 失败") << std::endl;
+    printSeparator();
+    return passed;
+}
+
+// 按给定参数构造全部被测目标（扫描模式下每个扫描点重新构造）
+static std::vector<BenchTarget> makeTargets(int num_tasks, int chunk_size, int num_threads,
+                                            prime_output::Format format, const std::string& cache_dir) {
+    std::vector<std::string> seastar_args = {
+        "-c", std::to_string(num_threads),
+        "-t", std::to_string(num_tasks),
+        "-n", std::to_string(chunk_size),
+        "-f", prime_output::format_name(format),
+        "--logger-ostream-type", "none"
+    };
+    if (!cache_dir.empty()) {
+        seastar_args.push_back("--cache-dir");
+        seastar_args.push_back(cache_dir);
+    }
+
+    auto seastar_target = [&](const std::string& name, const std::string& desc) {
+        BenchTarget t;
+        t.name = name;
+        t.description = desc;
+        t.args = seastar_args;
+        t.args.push_back("-o");
+        t.args.push_back(prime_output::with_extension("./output/" + name + "s.csv", format));
+        return t;
+    };
+    auto in_process_target = [](const std::string& name, const std::string& desc,
+                                harness::Strategy strategy) {
+        BenchTarget t;
+        t.name = name;
+        t.description = desc;
+        t.in_process = true;
+        t.strategy = strategy;
+        return t;
+    };
+
+    return {
+        in_process_target("sequence_prime", "顺序计算, 进程内", harness::Strategy::sequence),
+        in_process_target("minimax_libfork_prime", "libfork工作窃取, 进程内", harness::Strategy::worker_threads),
+        in_process_target("glm5_libfork_prime", "libfork fork-join, 进程内", harness::Strategy::fork_join),
+        seastar_target("minimax_seastar_prime", "Seastar工作窃取"),
+        seastar_target("glm5_seastar_prime", "Seastar框架"),
+        seastar_target("sonnet46_seastar_prime", "Seastar分段筛法"),
+        seastar_target("kimi_seastar_prime", "Seastar集中式队列"),
+        seastar_target("dk4_seastar_prime", "Seastar集中式队列+async"),
+    };
+}
+
+// 预热 + 采样，返回每个目标的采样结果（已 finalize）
+static std::vector<FrameworkResult> runBenchmarks(const BenchConfig& cfg,
+                                                  const std::vector<BenchTarget>& targets) {
+    std::vector<FrameworkResult> results(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        results[i].name = targets[i].name;
+        results[i].in_process = targets[i].in_process;
+        results[i].runs.reserve(cfg.repeat);
+    }
+
+    // 轮询交错：每一轮依次运行所有框架，避免系统状态漂移只影响某个框架
+    int rounds = cfg.warmup + cfg.repeat;
+    for (int round = 0; round < rounds; ++round) {
+        bool is_warmup = round < cfg.warmup;
+        std::cout << "\n" << (is_warmup ? "预热" : "采样") << " "
+                  << (is_warmup ? round + 1 : round - cfg.warmup + 1) << "/"
+                  << (is_warmup ? cfg.warmup : cfg.repeat) << std::endl;
+        for (size_t i = 0; i < targets.size(); ++i) {
+            const auto& t = targets[i];
+            std::cout << "[" << i + 1 << "/" << targets.size() << "] 运行 " << t.name
+                      << " (" << t.description << ")..." << std::endl;
+            BenchmarkResult r = t.in_process
+                ? runInProcess(t.name, t.strategy, cfg.num_tasks, cfg.chunk_size, cfg.num_threads,
+                               cfg.format, cfg.perf)
+                : runProgram(t.name, t.args, cfg.perf);
+            if (!is_warmup) {
+                results[i].runs.push_back(std::move(r));
+            }
+        }
+    }
+
+    for (auto& fr : results) {
+        finalizeResult(fr);
+    }
+    return results;
+}
+
+// ---------------------------------------------------------------------------
+// 扩展性扫描
+//   --sweep-cores 1,2,4,...  固定区间，逐点改变线程数/分片数（强扩展）
+//     加速比 S = T(p0) / T(p)，p0 为列表中最小的核数；相对核数 r = p / p0
+//     并行效率 E = S / r；Karp–Flatt 串行比例 e = (1/S - 1/r) / (1 - 1/r)
+//   --sweep-range 8,16,32,...  固定线程数，逐点改变任务数（区间 = 任务数 × 区间大小）
+//     以同一点上的 sequence_prime 为 T(1)，r = 线程数
+// e 随核数上升说明开销在增长（调度、同步、内存带宽），e 基本不变说明受串行部分限制
+// ---------------------------------------------------------------------------
+
+enum class SweepKind { none, cores, range };
+
+struct SweepPoint {
+    int num_tasks = 0;
+    int num_threads = 0;
+    std::vector<FrameworkResult> results;
+};
+
+struct ScalingRow {
+    bool valid = false;
+    double speedup = 0.0;
+    double efficiency = 0.0;
+    double karp_flatt = 0.0;
+    bool has_karp_flatt = false;   // r == 1 时无定义
+    bool reference = false;        // 本身就是比较基准 (range 扫描中的 sequence_prime)
+};
+
+static ScalingRow scalingOf(double t_ref, double t, double r) {
+    ScalingRow row;
+    if (t_ref <= 0.0 || t <= 0.0 || r <= 0.0) return row;
+    row.valid = true;
+    row.speedup = t_ref / t;
+    row.efficiency = row.speedup / r;
+    if (r > 1.0) {
+        row.karp_flatt = (1.0 / row.speedup - 1.0 / r) / (1.0 - 1.0 / r);
+        row.has_karp_flatt = true;
+    }
+    return row;
+}
+
+// 第 point 个扫描点上第 fi 个框架的扩展性指标
+static ScalingRow sweepScaling(SweepKind kind, const std::vector<SweepPoint>& points,
+                               size_t point, size_t fi) {
+    const auto& fr = points[point].results[fi];
+    if (!fr.ok()) return {};
+    if (kind == SweepKind::cores) {
+        const auto& ref = points.front();
+        const auto& ref_fr = ref.results[fi];
+        if (!ref_fr.ok()) return {};
+        double r = static_cast<double>(points[point].num_threads) / ref.num_threads;
+        return scalingOf(ref_fr.summary.median, fr.summary.median, r);
+    }
+    // range：与同一点上的顺序版本比较，顺序版本自身只作基准
+    if (fi == 0) {
+        ScalingRow ref;
+        ref.reference = true;
+        return ref;
+    }
+    const auto& seq = points[point].results.front();
+    if (!seq.ok()) return {};
+    return scalingOf(seq.summary.median, fr.summary.median, points[point].num_threads);
+}
+
+static void printSweep(SweepKind kind, const std::vector<SweepPoint>& points, int chunk_size) {
+    printSeparator();
+    std::cout << (kind == SweepKind::cores ? "核数扩展性 (强扩展, 相对最小核数)"
+                                           : "区间扩展性 (相对同区间 sequence_prime)") << std::endl;
+    printSeparator();
+    // 中文表头按 UTF-8 字节数补宽，保证与数据列对齐
+    std::cout << std::left << std::setw(26) << "框架"
+              << std::right << std::setw(10) << "核数"
+              << std::right << std::setw(14) << "区间"
+              << std::right << std::setw(15) << "中位数(ms)"
+              << std::right << std::setw(13) << "加速比"
+              << std::right << std::setw(12) << "效率"
+              << std::right << std::setw(12) << "Karp-Flatt" << std::endl;
+    printSeparator('-');
+    for (size_t fi = 0; fi < points.front().results.size(); ++fi) {
+        for (size_t pi = 0; pi < points.size(); ++pi) {
+            const auto& pt = points[pi];
+            const auto& fr = pt.results[fi];
+            auto row = sweepScaling(kind, points, pi, fi);
+            std::cout << std::left << std::setw(24) << fr.name
+                      << std::right << std::setw(8) << pt.num_threads
+                      << std::right << std::setw(12) << static_cast<uint64_t>(pt.num_tasks) * chunk_size
+                      << std::right << std::setw(fr.ok() ? 12 : 14) << (fr.ok() ? formatMs(fr.summary.median) : std::string("失败"))
+                      << std::right << std::setw(10) << (row.valid ? formatMs(row.speedup, 2) + "x" : std::string(row.reference ? "ref" : "n/a"))
+                      << std::right << std::setw(10) << (row.valid ? formatMs(row.efficiency * 100.0, 1) + "%" : std::string(row.reference ? "ref" : "n/a"))
+                      << std::right << std::setw(12) << (row.has_karp_flatt ? formatMs(row.karp_flatt, 3) : std::string(row.reference ? "ref" : "n/a"))
+                      << std::endl;
+        }
+        if (fi + 1 < points.front().results.size()) printSeparator('-');
+    }
+    printSeparator();
+}
+
+// 长表格式：每个 (框架, 扫描点) 一行，可直接用于绘图
+static std::string sweepToCsv(SweepKind kind, const std::vector<SweepPoint>& points, int chunk_size) {
+    std::ostringstream oss;
+    oss << "sweep,framework,mode,cores,tasks,chunk_size,range_end,samples,failures,"
+           "median_ms,ci_low_ms,ci_high_ms,mnums_per_s,speedup,efficiency,karp_flatt\n";
+    oss << std::fixed << std::setprecision(4);
+    for (size_t fi = 0; fi < points.front().results.size(); ++fi) {
+        for (size_t pi = 0; pi < points.size(); ++pi) {
+            const auto& pt = points[pi];
+            const auto& fr = pt.results[fi];
+            auto row = sweepScaling(kind, points, pi, fi);
+            uint64_t range_end = static_cast<uint64_t>(pt.num_tasks) * chunk_size;
+            oss << (kind == SweepKind::cores ? "cores" : "range") << ','
+                << fr.name << ',' << (fr.in_process ? "in_process" : "child") << ','
+                << pt.num_threads << ',' << pt.num_tasks << ',' << chunk_size << ','
+                << range_end << ',' << fr.summary.n << ',' << fr.failures << ',';
+            if (fr.ok()) {
+                oss << fr.summary.median << ',' << fr.summary.ci_low << ',' << fr.summary.ci_high << ','
+                    << static_cast<double>(range_end) / (fr.summary.median * 1000.0);
+            } else {
+                oss << ",,,";
+            }
+            oss << ',';
+            if (row.valid) oss << row.speedup;
+            oss << ',';
+            if (row.valid) oss << row.efficiency;
+            oss << ',';
+            if (row.has_karp_flatt) oss << row.karp_flatt;
+            oss << '\n';
+        }
+    }
+    return oss.str();
+}
+
+static json::Value sweepToJson(SweepKind kind, const BenchConfig& cfg,
+                               const std::vector<SweepPoint>& points) {
+    json::Value root = json::Value::object();
+    root["schema"] = 1;
+    root["sweep"] = kind == SweepKind::cores ? "cores" : "range";
+    json::Value config = json::Value::object();
+    config["chunk_size"] = cfg.chunk_size;
+    config["repeat"] = cfg.repeat;
+    config["warmup"] = cfg.warmup;
+    config["format"] = prime_output::format_name(cfg.format);
+    root["config"] = std::move(config);
+    root["host"] = hostInfo();
+    json::Value pts = json::Value::array();
+    for (size_t pi = 0; pi < points.size(); ++pi) {
+        const auto& pt = points[pi];
+        json::Value p = json::Value::object();
+        p["cores"] = pt.num_threads;
+        p["tasks"] = pt.num_tasks;
+        json::Value fws = json::Value::array();
+        for (size_t fi = 0; fi < pt.results.size(); ++fi) {
+            const auto& fr = pt.results[fi];
+            auto row = sweepScaling(kind, points, pi, fi);
+            json::Value f = json::Value::object();
+            f["name"] = fr.name;
+            f["failures"] = fr.failures;
+            f["summary"] = summaryToJson(fr.summary);
+            if (row.valid) {
+                f["speedup"] = row.speedup;
+                f["efficiency"] = row.efficiency;
+            }
+            if (row.has_karp_flatt) f["karp_flatt"] = row.karp_flatt;
+            if (row.reference) f["reference"] = true;
+            fws.push_back(std::move(f));
+        }
+        p["frameworks"] = std::move(fws);
+        pts.push_back(std::move(p));
+    }
+    root["points"] = std::move(pts);
+    return root;
+}
+
+// 解析 "1,2,4,8" 形式的正整数列表，去重并升序
+static bool parseIntList(const char* arg, const char* name, std::vector<int>& values) {
+    values.clear();
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int v = 0;
+        try {
+            size_t idx = 0;
+            v = std::stoi(item, &idx);
+            if (idx != item.size() || v <= 0) throw std::invalid_argument(item);
+        } catch (const std::exception&) {
+            std::cerr << "错误: 无效的 " << name << " 参数 " << arg << std::endl;
+            return false;
+        }
+        values.push_back(v);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    if (values.empty()) {
+        std::cerr << "错误: " << name << " 列表为空" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 解析 "5%"、"5" 或 "2.5%"，单位均为百分比
+static bool parsePercentArg(const char* arg, double& value) {
+    std::string s(arg);
+    if (!s.empty() && s.back() == '%') s.pop_back();
+    try {
+        size_t idx = 0;
+        value = std::stod(s, &idx);
+        if (idx != s.size() || value < 0) throw std::invalid_argument(arg);
+        return true;
+    } catch (const std::exception&) {
+        std::cerr << "错误: 无效的 --max-regress 参数 " << arg << std::endl;
+        return false;
+    }
+}
+
+static void printUsage(const char* prog) {
+    std::cout << "用法: " << prog << " [-t 任务数] [-n 区间大小] [-c 线程数] [-f csv|bin|bitmap] [--repeat N] [--warmup K]\n"
+              << "       [--json 文件] [--csv 文件] [--baseline 基线.json --max-regress 5%]\n"
+              << "       [--sweep-cores 1,2,4,... | --sweep-range 8,16,32,...] [--cache-dir 目录]\n" << std::endl;
+    std::cout << "参数说明:" << std::endl;
+    std::cout << "  -t <N>            任务总数 (默认: 32)" << std::endl;
+    std::cout << "  -n <N>            区间大小 (默认: 100000)" << std::endl;
+    std::cout << "  -c <N>            线程数 (默认: 32)" << std::endl;
+    std::cout << "  -r, --repeat <N>  每个框架的采样次数 (默认: 1)" << std::endl;
+    std::cout << "  -w, --warmup <K>  每个框架的预热次数，结果丢弃 (默认: 0)" << std::endl;
+    std::cout << "  --json <文件>      写出 JSON 结果 (配置、主机信息、每次采样耗时、素数总数、退出码)" << std::endl;
+    std::cout << "  --csv <文件>       写出每次采样一行的 CSV" << std::endl;
+    std::cout << "  --baseline <文件>  与之前 --json 写出的基线对比，任一框架退化则退出码为 2" << std::endl;
+    std::cout << "  --max-regress <P>  允许的中位数退化百分比 (默认: 5%)" << std::endl;
+    std::cout << "  -f, --format <F>  结果文件格式: csv、bin 或 bitmap (默认: csv)，同时传给 Seastar 子进程" << std::endl;
+    std::cout << "  --perf             采集硬件计数器 (cycles、instructions、L1D/LLC/分支未命中、上下文切换、CPU迁移)" << std::endl;
+    std::cout << "  --sweep-cores <L>  逐个核数运行 (如 1,2,4,8)，输出加速比、并行效率与 Karp-Flatt 串行比例" << std::endl;
+    std::cout << "  --sweep-range <L>  固定线程数，逐个任务数运行 (区间 = 任务数 × 区间大小)，相对 sequence_prime 计算" << std::endl;
+    std::cout << "                     扫描模式下 --csv 写出扫描长表 (默认 ./output/sweep_<cores|range>.csv)" << std::endl;
+    std::cout << "  --cache-dir <D>    持久素数缓存目录，进程内框架与 Seastar 子进程共用；已缓存的区间按 mmap 读取" << std::endl;
+    std::cout << "\n示例:" << std::endl;
+    std::cout << "  " << prog << " -t 10 -n 100000 -c 8" << std::endl;
+    std::cout << "  " << prog << " -t 20 -n 100000 -c 16 --repeat 10 --warmup 2" << std::endl;
+    std::cout << "  " << prog << " --repeat 10 --json new.json --baseline main.json --max-regress 5%" << std::endl;
+    std::cout << "  " << prog << " -t 64 --repeat 5 --sweep-cores 1,2,4,8,16,32 --csv scaling.csv" << std::endl;
+}
+
+static bool parseIntArg(const char* arg, const char* name, int& value) {
+    try {
+        value = std::stoi(arg);
+        return true;
+    } catch (const std::exception&) {
+        std::cerr << "错误: 无效的 " << name << " 参数" << std::endl;
+        return false;
+    }
 }
 
 int main(int argc, char** argv) {
     int num_tasks = 32;
     int chunk_size = 100000;
     int num_threads = 32;
+    int repeat = 1;
+    int warmup = 0;
+    std::string json_file;
+    std::string csv_file;
+    std::string baseline_file;
+    double max_regress_pct = 5.0;
+    bool collect_perf = false;
+    prime_output::Format format = prime_output::Format::csv;
+    SweepKind sweep = SweepKind::none;
+    std::vector<int> sweep_values;
+    std::string cache_dir;
+
+    enum LongOnly { kOptJson = 1000, kOptCsv, kOptBaseline, kOptMaxRegress, kOptPerf,
+                    kOptSweepCores, kOptSweepRange, kOptCacheDir };
+    static const option long_options[] = {
+        {"repeat", required_argument, nullptr, 'r'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"json", required_argument, nullptr, kOptJson},
+        {"csv", required_argument, nullptr, kOptCsv},
+        {"baseline", required_argument, nullptr, kOptBaseline},
+        {"max-regress", required_argument, nullptr, kOptMaxRegress},
+        {"format", required_argument, nullptr, 'f'},
+        {"perf", no_argument, nullptr, kOptPerf},
+        {"sweep-cores", required_argument, nullptr, kOptSweepCores},
+        {"sweep-range", required_argument, nullptr, kOptSweepRange},
+        {"cache-dir", required_argument, nullptr, kOptCacheDir},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
 
     int opt;
-    while ((opt = getopt(argc, argv, "t:n:c:h")) != -1) {
+    while ((opt = getopt_long(argc, argv, "t:n:c:r:w:f:h", long_options, nullptr)) != -1) {
         switch (opt) {
             case 't':
-                try { num_tasks = std::stoi(optarg); }
-                catch (const std::exception&) { std::cerr << "错误: 无效的 -t 参数" << std::endl; return 1; }
+                if (!parseIntArg(optarg, "-t", num_tasks)) return 1;
                 break;
             case 'n':
-                try { chunk_size = std::stoi(optarg); }
-                catch (const std::exception&) { std::cerr << "错误: 无效的 -n 参数" << std::endl; return 1; }
+                if (!parseIntArg(optarg, "-n", chunk_size)) return 1;
                 break;
             case 'c':
-                try { num_threads = std::stoi(optarg); }
-                catch (const std::exception&) { std::cerr << "错误: 无效的 -c 参数" << std::endl; return 1; }
+                if (!parseIntArg(optarg, "-c", num_threads)) return 1;
+                break;
+            case 'r':
+                if (!parseIntArg(optarg, "--repeat", repeat)) return 1;
+                break;
+            case 'w':
+                if (!parseIntArg(optarg, "--warmup", warmup)) return 1;
+                break;
+            case kOptJson:
+                json_file = optarg;
+                break;
+            case kOptCsv:
+                csv_file = optarg;
+                break;
+            case kOptBaseline:
+                baseline_file = optarg;
+                break;
+            case kOptMaxRegress:
+                if (!parsePercentArg(optarg, max_regress_pct)) return 1;
+                break;
+            case 'f':
+                if (!prime_output::parse_format(optarg, format)) {
+                    std::cerr << "错误: 无效的输出格式 " << optarg << " (可选: csv, bin, bitmap)" << std::endl;
+                    return 1;
+                }
+                break;
+            case kOptPerf:
+                collect_perf = true;
+                break;
+            case kOptSweepCores:
+            case kOptSweepRange:
+                if (sweep != SweepKind::none) {
+                    std::cerr << "错误: --sweep-cores 与 --sweep-range 只能指定一个" << std::endl;
+                    return 1;
+                }
+                sweep = (opt == kOptSweepCores) ? SweepKind::cores : SweepKind::range;
+                if (!parseIntList(optarg, opt == kOptSweepCores ? "--sweep-cores" : "--sweep-range",
+                                  sweep_values)) return 1;
+                break;
+            case kOptCacheDir:
+                cache_dir = optarg;
                 break;
             case 'h':
             default:
-                std::cout << "用法: " << argv[0] << " [-t 任务数] [-n 区间大小] [-c 线程数]\n" << std::endl;
-                std::cout << "参数说明:" << std::endl;
-                std::cout << "  -t <N>   任务总数 (默认: 32)" << std::endl;
-                std::cout << "  -n <N>   区间大小 (默认: 100000)" << std::endl;
-                std::cout << "  -c <N>   线程数 (默认: 32)" << std::endl;
-                std::cout << "\n示例:" << std::endl;
-                std::cout << "  " << argv[0] << " -t 10 -n 100000 -c 8" << std::endl;
-                std::cout << "  " << argv[0] << " -t 20 -n 100000 -c 16" << std::endl;
+                printUsage(argv[0]);
                 return (opt == 'h') ? 0 : 1;
         }
     }
@@ -239,19 +1211,18 @@ int main(int argc, char** argv) {
     if (num_tasks <= 0) num_tasks = 32;
     if (chunk_size <= 0) chunk_size = 100000;
     if (num_threads <= 0) num_threads = 32;
+    if (repeat <= 0) repeat = 1;
+    if (warmup < 0) warmup = 0;
 
-    std::vector<std::string> base_args = {
-        "-t", std::to_string(num_tasks),
-        "-n", std::to_string(chunk_size),
-        "-c", std::to_string(num_threads)
-    };
+    if (format == prime_output::Format::bitmap && !prime_output::bitmap_compatible(chunk_size)) {
+        std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+        return 1;
+    }
 
-    std::vector<std::string> seastar_args = {
-        "-c", std::to_string(num_threads),
-        "-t", std::to_string(num_tasks),
-        "-n", std::to_string(chunk_size),
-        "--logger-ostream-type", "none"
-    };
+    if (sweep != SweepKind::none && !baseline_file.empty()) {
+        std::cerr << "错误: 扫描模式不支持 --baseline" << std::endl;
+        return 1;
+    }
 
     printSeparator();
     std::cout << "素数计算性能基准测试" << std::endl;
@@ -260,63 +1231,114 @@ int main(int argc, char** argv) {
     std::cout << "任务数:   " << num_tasks << std::endl;
     std::cout << "区间大小: " << chunk_size << std::endl;
     std::cout << "线程数:   " << num_threads << std::endl;
+    std::cout << "采样次数: " << repeat << " (预热 " << warmup << ")" << std::endl;
+    std::cout << "输出格式: " << prime_output::format_name(format) << std::endl;
+    if (!cache_dir.empty()) {
+        std::cout << "素数缓存: " << cache_dir << std::endl;
+    }
+    if (sweep != SweepKind::none) {
+        std::cout << (sweep == SweepKind::cores ? "扫描核数: " : "扫描任务数: ");
+        for (size_t i = 0; i < sweep_values.size(); ++i) {
+            std::cout << (i ? "," : "") << sweep_values[i];
+        }
+        std::cout << std::endl;
+    }
     printSeparator();
 
+    if (collect_perf) {
+        perf::Counters probe;
+        if (probe.open() == 0) {
+            std::cerr << "警告: perf_event_open 不可用，已关闭 --perf"
+                      << " (检查 /proc/sys/kernel/perf_event_paranoid 或容器权限)" << std::endl;
+            collect_perf = false;
+        }
+    }
+
+    // 进程内框架共用同一缓存；块映射在整个基准期间保留
+    prime_cache::Cache cache;
+    if (!cache_dir.empty()) {
+        if (!cache.open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << cache.error() << std::endl;
+            return 1;
+        }
+        prime_cache::install(&cache);
+    }
+
     std::string output_dir = "./output";
     if (mkdir(output_dir.c_str(), 0755) != 0 && errno != EEXIST) {
         std::cerr << "警告: 无法创建输出目录: " << std::strerror(errno) << std::endl;
     }
 
-    std::vector<BenchmarkResult> results;
-
-    std::cout << "\n[1/8] 运行 sequence_prime (顺序计算)..." << std::endl;
-    results.push_back(runProgram("sequence_prime", base_args));
-    std::rename("sequence_prime.csv", "./output/sequence_prime.csv");
-
-    std::cout << "[2/8] 运行 minimax_libfork_prime (libfork工作窃取)..." << std::endl;
-    results.push_back(runProgram("minimax_libfork_prime", base_args));
-    std::rename("minimax_libfork_prime.csv", "./output/minimax_libfork_prime.csv");
-
-    std::cout << "[3/8] 运行 glm5_libfork_prime (libfork fork-join)..." << std::endl;
-    results.push_back(runProgram("glm5_libfork_prime", base_args));
-    std::rename("glm5_libfork_prime.csv", "./output/glm5_libfork_prime.csv");
-
-    std::cout << "[4/8] 运行 minimax_seastar_prime (Seastar工作窃取)..." << std::endl;
-    auto sargs4 = seastar_args;
-    sargs4.push_back("-o");
-    sargs4.push_back("./output/minimax_seastar_primes.csv");
-    results.push_back(runProgram("minimax_seastar_prime", sargs4));
+    BenchConfig cfg{num_tasks, chunk_size, num_threads, repeat, warmup, collect_perf, format};
 
-    std::cout << "[5/8] 运行 glm5_seastar_prime (Seastar框架)..." << std::endl;
-    auto sargs5 = seastar_args;
-    sargs5.push_back("-o");
-    sargs5.push_back("./output/glm5_seastar_primes.csv");
-    results.push_back(runProgram("glm5_seastar_prime", sargs5));
-
-    std::cout << "[6/8] 运行 sonnet46_seastar_prime (Seastar分段筛法)..." << std::endl;
-    auto sargs6 = seastar_args;
-    sargs6.push_back("-o");
-    sargs6.push_back("./output/sonnet46_seastar_primes.csv");
-    results.push_back(runProgram("sonnet46_seastar_prime", sargs6));
+    if (sweep != SweepKind::none) {
+        std::vector<SweepPoint> points;
+        for (int v : sweep_values) {
+            BenchConfig point_cfg = cfg;
+            if (sweep == SweepKind::cores) {
+                point_cfg.num_threads = v;
+            } else {
+                point_cfg.num_tasks = v;
+            }
+            std::cout << "\n扫描点: 核数 " << point_cfg.num_threads
+                      << ", 任务数 " << point_cfg.num_tasks << std::endl;
+            auto targets = makeTargets(point_cfg.num_tasks, point_cfg.chunk_size, point_cfg.num_threads,
+                                       point_cfg.format, cache_dir);
+            points.push_back(SweepPoint{point_cfg.num_tasks, point_cfg.num_threads,
+                                        runBenchmarks(point_cfg, targets)});
+        }
 
-    std::cout << "[7/8] 运行 kimi_seastar_prime (Seastar集中式队列)..." << std::endl;
-    auto sargs7 = seastar_args;
-    sargs7.push_back("-o");
-    sargs7.push_back("./output/kimi_seastar_primes.csv");
-    results.push_back(runProgram("kimi_seastar_prime", sargs7));
+        printSweep(sweep, points, chunk_size);
+        int status = 0;
+        for (const auto& pt : points) {
+            for (const auto& fr : pt.results) {
+                if (!fr.ok()) {
+                    std::cerr << "错误: " << fr.name << " 在核数 " << pt.num_threads << ", 任务数 "
+                              << pt.num_tasks << " 处没有成功的采样" << std::endl;
+                    status = 1;
+                }
+            }
+        }
+        if (csv_file.empty()) {
+            csv_file = output_dir + (sweep == SweepKind::cores ? "/sweep_cores.csv" : "/sweep_range.csv");
+        }
+        if (writeTextFile(csv_file, sweepToCsv(sweep, points, chunk_size))) {
+            std::cout << "扫描 CSV 已写入: " << csv_file << std::endl;
+        } else {
+            status = 1;
+        }
+        if (!json_file.empty()) {
+            if (writeTextFile(json_file, json::dump(sweepToJson(sweep, cfg, points)))) {
+                std::cout << "JSON 结果已写入: " << json_file << std::endl;
+            } else {
+                status = 1;
+            }
+        }
+        return status;
+    }
 
-    std::cout << "[8/8] 运行 dk4_seastar_prime (Seastar集中式队列+async)..." << std::endl;
-    auto sargs8 = seastar_args;
-    sargs8.push_back("-o");
-    sargs8.push_back("./output/dk4_seastar_primes.csv");
-    results.push_back(runProgram("dk4_seastar_prime", sargs8));
+    std::vector<FrameworkResult> results = runBenchmarks(cfg, makeTargets(num_tasks, chunk_size, num_threads, format, cache_dir));
 
     if (results.empty()) {
         std::cerr << "错误: 无基准测试结果" << std::endl;
         return 1;
     }
 
-    printResults(results);
+    bool all_consistent = printResults(results);
+
+    if (collect_perf) {
+        printPerfCounters(results, cfg.numbers());
+    }
+    if (!json_file.empty() && writeTextFile(json_file, json::dump(resultsToJson(cfg, results, all_consistent)))) {
+        std::cout << "JSON 结果已写入: " << json_file << std::endl;
+    }
+    if (!csv_file.empty() && writeTextFile(csv_file, resultsToCsv(results))) {
+        std::cout << "CSV 结果已写入: " << csv_file << std::endl;
+    }
+
+    if (!baseline_file.empty() && !checkBaseline(baseline_file, max_regress_pct, cfg, results)) {
+        return 2;
+    }
 
     return 0;
 }
@@ -0,0 +1,86 @@
+// prime_bin2csv: 将 --format=bin 输出的二进制结果文件转换回 CSV
+// 输出与 --format=csv 逐字节一致：<start>-<end>,<core>,p1,p2,...
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <getopt.h>
+
+#include "prime_output.hpp"
+
+static void printUsage(const char* prog) {
+    std::cout << "用法: " << prog << " -i 输入.bin [-o 输出.csv]\n" << std::endl;
+    std::cout << "参数说明:" << std::endl;
+    std::cout << "  -i <文件> 二进制结果文件 (PRB1 格式)" << std::endl;
+    std::cout << "  -o <文件> 输出CSV文件路径 (默认: 标准输出)" << std::endl;
+    std::cout << "\n示例:" << std::endl;
+    std::cout << "  " << prog << " -i sequence_prime.bin -o sequence_prime.csv" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string input_file;
+    std::string output_file;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:h")) != -1) {
+        switch (opt) {
+            case 'i':
+                input_file = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'h':
+            default:
+                printUsage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if (input_file.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::ifstream in(input_file, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "错误: 无法打开输入文件 " << input_file << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!output_file.empty()) {
+        file.open(output_file, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "错误: 无法打开输出文件 " << output_file << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output_file.empty() ? std::cout : file;
+
+    prime_output::BinReader reader(in);
+    if (!reader.open()) {
+        std::cerr << "错误: " << input_file << ": " << reader.error() << std::endl;
+        return 1;
+    }
+
+    prime_output::BinRecord record;
+    std::string line;
+    line.reserve(128 * 1024);
+    uint64_t total_primes = 0;
+    while (reader.next(record)) {
+        line.clear();
+        prime_output::append_csv(line, record.start, record.end, record.core, record.primes);
+        out.write(line.data(), static_cast<std::streamsize>(line.size()));
+        total_primes += record.primes.size();
+    }
+    if (!reader.error().empty()) {
+        std::cerr << "错误: " << input_file << " 第 " << reader.records() + 1
+                  << " 条记录: " << reader.error() << std::endl;
+        return 1;
+    }
+    out.flush();
+
+    std::cerr << "已转换 " << reader.records() << " 条记录, 素数总数 " << total_primes << std::endl;
+    return out ? 0 : 1;
+}
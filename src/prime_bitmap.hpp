@@ -0,0 +1,102 @@
+#pragma once
+// Read-only view of a --format=bitmap result file (layout in prime_output.hpp).
+// The file is mmap'd; is_prime is a single bit test, next_prime scans 64-bit
+// words with ctz. Queries at or beyond limit() are outside the sieved range.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace prime_bitmap {
+
+class Reader {
+public:
+    Reader() = default;
+    ~Reader() { close(); }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error_ = std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            error_ = std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                error_ = std::strerror(errno);
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            ::madvise(p, size_, MADV_RANDOM);
+            data_ = static_cast<const unsigned char*>(p);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void close() {
+        if (data_) ::munmap(const_cast<unsigned char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    // 文件覆盖 [0, limit())
+    uint64_t limit() const { return static_cast<uint64_t>(size_) * 16; }
+    const std::string& error() const { return error_; }
+
+    bool is_prime(uint64_t n) const {
+        if (n == 2) return limit() > 2;
+        if ((n & 1) == 0 || n >= limit()) return false;
+        uint64_t idx = n / 2;
+        return (data_[idx / 8] >> (idx % 8)) & 1;
+    }
+
+    // 大于 n 的最小素数；超出文件范围返回 0
+    uint64_t next_prime(uint64_t n) const {
+        if (n < 2) return limit() > 2 ? 2 : 0;
+        uint64_t bits = static_cast<uint64_t>(size_) * 8;
+        uint64_t idx = (n + 1) / 2;   // 第一个大于 n 的奇数 2*idx+1
+        if (idx >= bits) return 0;
+
+        // 先按字节对齐到 8 字节边界，再按 64 位字扫描
+        uint64_t byte = idx / 8;
+        unsigned b = static_cast<unsigned>(data_[byte]) >> (idx % 8);
+        if (b) return 2 * (idx + static_cast<uint64_t>(__builtin_ctz(b))) + 1;
+        for (++byte; byte < size_ && (byte % 8) != 0; ++byte) {
+            if (data_[byte]) return 2 * (byte * 8 + static_cast<uint64_t>(__builtin_ctz(data_[byte]))) + 1;
+        }
+        for (; byte + 8 <= size_; byte += 8) {
+            uint64_t w;
+            std::memcpy(&w, data_ + byte, sizeof(w));
+            if (w) return 2 * (byte * 8 + static_cast<uint64_t>(__builtin_ctzll(w))) + 1;
+        }
+        for (; byte < size_; ++byte) {
+            if (data_[byte]) return 2 * (byte * 8 + static_cast<uint64_t>(__builtin_ctz(data_[byte]))) + 1;
+        }
+        return 0;
+    }
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    std::string error_;
+};
+
+} // namespace prime_bitmap
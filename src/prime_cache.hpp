@@ -0,0 +1,281 @@
+#pragma once
+// Opt-in on-disk prime cache shared across runs (--cache-dir <dir>).
+//
+// The number line is cut into fixed blocks of kBlockNumbers integers. Block k
+// is stored as "<dir>/primes-<k>.bitmap", the raw odd-only sieve of
+// [k * kBlockNumbers, (k + 1) * kBlockNumbers) in the --format=bitmap layout
+// (prime::sieve_bitmap). A lookup maps the blocks a range touches and reads
+// the primes straight out of the page cache; a missing block is sieved whole,
+// written to a temporary file and renamed into place, so concurrent runs and
+// processes only ever see complete files. Within a process, threads that miss
+// the same block wait for the one computing it instead of sieving it again.
+// Mappings stay open for the life of the Cache (one per block: 128 KiB each,
+// about 4800 mappings for a range of 10^10).
+//
+// The cache stores sieve output, so it must be cleared after changing the
+// sieve kernel; scripts/verify_sieve.sh only uses it when asked to.
+// If the directory is not writable, computed blocks are kept in memory.
+//
+// Seastar programs use ThreadCaches instead: every reactor thread gets its own
+// Cache, so a shard never waits (std::shared_future::get, which would stall
+// its reactor) for a block another shard is sieving. The shards still share
+// the block files, and rename makes each one visible only once complete.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "prime_sieve.hpp"
+
+namespace prime_cache {
+
+inline constexpr uint64_t kBlockNumbers = uint64_t{1} << 21;   // 每块 2M 个整数
+inline constexpr size_t kBlockBytes = kBlockNumbers / 16;       // = 128 KiB 位图
+
+class Cache {
+public:
+    Cache() = default;
+    ~Cache() {
+        for (const uint64_t* words : mappings_) {
+            ::munmap(const_cast<uint64_t*>(words), kBlockBytes);
+        }
+    }
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+
+    // 目录不存在时创建 (只建最后一级)
+    bool open(const std::string& dir) {
+        if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            error_ = dir + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            error_ = dir + ": 不是目录";
+            return false;
+        }
+        dir_ = dir;
+        return true;
+    }
+
+    // [start, end) 内的全部素数，与 prime::segmented_sieve 结果相同
+    std::vector<uint64_t> sieve(uint64_t start, uint64_t end) {
+        std::vector<uint64_t> result;
+        if (end <= 2) [[unlikely]] return result;
+        if (start < 2) start = 2;
+        result.reserve((end - start) / 15);
+        if (start == 2) result.push_back(2);
+
+        for (uint64_t k = start / kBlockNumbers; k * kBlockNumbers < end; ++k) {
+            uint64_t base = k * kBlockNumbers;
+            const uint64_t* words = block(k);
+            // 位 b 表示奇数 base + 2b + 1；取 [lo, hi) 内的奇数
+            uint64_t lo = std::max(start, base) - base;
+            uint64_t hi = std::min(end, base + kBlockNumbers) - base;
+            uint64_t first_bit = lo / 2;
+            uint64_t last_bit = hi / 2;   // 不含
+            for (uint64_t w = first_bit / 64; w * 64 < last_bit; ++w) {
+                uint64_t word = words[w];
+                if (w == first_bit / 64) word &= ~uint64_t{0} << (first_bit % 64);
+                if ((w + 1) * 64 > last_bit) word &= (uint64_t{1} << (last_bit % 64)) - 1;
+                while (word) {
+                    result.push_back(base + 2 * (w * 64 + static_cast<uint64_t>(__builtin_ctzll(word))) + 1);
+                    word &= word - 1;
+                }
+            }
+        }
+        return result;
+    }
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }       // 从磁盘映射的块数
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }   // 新筛并写入的块数
+    const std::string& dir() const { return dir_; }
+    const std::string& error() const { return error_; }
+
+private:
+    std::string block_path(uint64_t k) const {
+        return dir_ + "/primes-" + std::to_string(k) + ".bitmap";
+    }
+
+    // 第 k 块的位图 (kBlockBytes 字节)；第一个访问的线程负责加载，其余等待
+    const uint64_t* block(uint64_t k) {
+        std::promise<const uint64_t*> promise;
+        std::shared_future<const uint64_t*> ready;
+        bool owner = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto [it, inserted] = blocks_.try_emplace(k);
+            if (inserted) {
+                it->second = promise.get_future().share();
+                owner = true;
+            }
+            ready = it->second;
+        }
+        if (owner) {
+            try {
+                promise.set_value(load(k));
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        }
+        return ready.get();
+    }
+
+    const uint64_t* load(uint64_t k) {
+        if (const uint64_t* words = map_block(k)) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return words;
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        thread_local std::vector<uint64_t> words;
+        prime::sieve_bitmap(k * kBlockNumbers, (k + 1) * kBlockNumbers, words);
+        if (store_block(k, words)) {
+            if (const uint64_t* mapped = map_block(k)) return mapped;
+        }
+        // 无法落盘：保留在内存中
+        auto copy = std::make_unique<uint64_t[]>(words.size());
+        std::memcpy(copy.get(), words.data(), kBlockBytes);
+        std::lock_guard<std::mutex> lock(mutex_);
+        owned_.push_back(std::move(copy));
+        return owned_.back().get();
+    }
+
+    // 映射已有的块文件；不存在或长度不符返回 nullptr
+    const uint64_t* map_block(uint64_t k) {
+        int fd = ::open(block_path(k).c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) == kBlockBytes) {
+            p = ::mmap(nullptr, kBlockBytes, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) return nullptr;
+        const auto* words = static_cast<const uint64_t*>(p);
+        std::lock_guard<std::mutex> lock(mutex_);
+        mappings_.push_back(words);
+        return words;
+    }
+
+    // 写临时文件后 rename，其他进程只会看到完整的块
+    bool store_block(uint64_t k, const std::vector<uint64_t>& words) {
+        std::string path = block_path(k);
+        std::string tmp = path + ".tmp." + std::to_string(::getpid()) + "." +
+                          std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        const char* data = reinterpret_cast<const char*>(words.data());
+        size_t left = kBlockBytes;
+        bool ok = true;
+        while (left > 0) {
+            ssize_t n = ::write(fd, data, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+        ok = (::close(fd) == 0) && ok;
+        if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::string dir_;
+    std::string error_;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, std::shared_future<const uint64_t*>> blocks_;
+    std::vector<const uint64_t*> mappings_;
+    std::vector<std::unique_ptr<uint64_t[]>> owned_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+// 每个线程 (Seastar shard) 一个 Cache，线程首次调用 local() 时创建
+class ThreadCaches {
+public:
+    bool open(const std::string& dir) {
+        Cache probe;
+        if (!probe.open(dir)) {
+            error_ = probe.error();
+            return false;
+        }
+        dir_ = dir;
+        return true;
+    }
+
+    Cache& local() {
+        thread_local const ThreadCaches* owner = nullptr;
+        thread_local Cache* cache = nullptr;
+        if (owner != this) {
+            std::lock_guard<std::mutex> lock(mutex_);   // 每个线程只进入一次
+            caches_.push_back(std::make_unique<Cache>());
+            caches_.back()->open(dir_);
+            owner = this;
+            cache = caches_.back().get();
+        }
+        return *cache;
+    }
+
+    uint64_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t total = 0;
+        for (const auto& cache : caches_) total += cache->hits();
+        return total;
+    }
+    uint64_t misses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t total = 0;
+        for (const auto& cache : caches_) total += cache->misses();
+        return total;
+    }
+    const std::string& dir() const { return dir_; }
+    const std::string& error() const { return error_; }
+
+private:
+    std::string dir_;
+    std::string error_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Cache>> caches_;
+};
+
+// 进程内启用的缓存；都为空时 sieve() 直接调用 prime::segmented_sieve
+inline std::atomic<Cache*> g_active{nullptr};
+inline std::atomic<ThreadCaches*> g_thread_active{nullptr};
+
+inline void install(Cache* cache) {
+    g_active.store(cache, std::memory_order_release);
+}
+
+inline void install(ThreadCaches* caches) {
+    g_thread_active.store(caches, std::memory_order_release);
+}
+
+// 供各程序替代 prime::segmented_sieve 调用
+inline std::vector<uint64_t> sieve(uint64_t start, uint64_t end) {
+    if (ThreadCaches* caches = g_thread_active.load(std::memory_order_acquire)) {
+        return caches->local().sieve(start, end);
+    }
+    if (Cache* cache = g_active.load(std::memory_order_acquire)) return cache->sieve(start, end);
+    return prime::segmented_sieve(start, end);
+}
+
+} // namespace prime_cache
@@ -0,0 +1,241 @@
+#pragma once
+// Append-only result file used by the writer thread of OrderedWriter.
+//
+// Bytes are copied into 1 MiB page-aligned blocks; a full block is submitted
+// at its file offset while the next one fills, so the thread that formats
+// results never waits for the disk unless every block is still in flight.
+//
+// Backends:
+//   io_uring  when built with PRIME_HAVE_LIBURING (CMake links liburing if it
+//             is found): up to kBlocks writes are in flight at once.
+//   pwrite    otherwise: each block is written synchronously on the calling
+//             (writer) thread.
+// The file is opened with O_DIRECT to keep the page cache out of the way; if
+// the filesystem refuses it (tmpfs, some network filesystems) the writer
+// silently falls back to buffered I/O. With O_DIRECT the last block is padded
+// to the alignment and the file is truncated to its exact length on close().
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef PRIME_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace prime_output {
+
+class FileWriter {
+public:
+    static constexpr size_t kBlockSize = 1024 * 1024;
+    static constexpr size_t kAlign = 4096;     // O_DIRECT 对齐 (偏移、长度、地址)
+    static constexpr unsigned kBlocks = 4;     // 块数 = 最多同时在途的写
+
+    FileWriter() = default;
+    ~FileWriter() { close(); }
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    bool open(const std::string& path) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+        if (fd_ < 0 && errno == EINVAL)
+#endif
+            fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0) {
+            error_ = errno;
+            return false;
+        }
+        for (auto& b : blocks_) {
+            void* mem = nullptr;
+            if (::posix_memalign(&mem, kAlign, kBlockSize) != 0) {
+                error_ = ENOMEM;
+                for (auto& allocated : blocks_) {
+                    std::free(allocated.data);
+                    allocated.data = nullptr;
+                }
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+            b = Block{static_cast<char*>(mem), 0, 0, 0, false};
+        }
+#ifdef PRIME_HAVE_LIBURING
+        uring_ = io_uring_queue_init(kBlocks, &ring_, 0) == 0;
+#endif
+        cur_ = 0;
+        used_ = 0;
+        offset_ = 0;
+        return true;
+    }
+
+    void write(const char* data, size_t len) {
+        while (len > 0) {
+            size_t n = std::min(len, kBlockSize - used_);
+            std::memcpy(blocks_[cur_].data + used_, data, n);
+            used_ += n;
+            data += n;
+            len -= n;
+            if (used_ == kBlockSize) {
+                submit(kBlockSize);
+                next_block();
+            }
+        }
+    }
+
+    // 写出剩余数据并关闭；返回此前是否有写入错误
+    bool close() {
+        if (fd_ < 0) return error_ == 0;
+        uint64_t total = offset_ + used_;
+        if (used_ > 0) {
+            size_t len = used_;
+            if (direct_) {
+                len = (used_ + kAlign - 1) / kAlign * kAlign;
+                std::memset(blocks_[cur_].data + used_, 0, len - used_);
+            }
+            submit(len);
+        }
+        for (auto& b : blocks_) wait(b);
+        if (direct_ && ::ftruncate(fd_, static_cast<off_t>(total)) != 0) set_error(errno);
+#ifdef PRIME_HAVE_LIBURING
+        if (uring_) io_uring_queue_exit(&ring_);
+#endif
+        if (::close(fd_) != 0) set_error(errno);
+        fd_ = -1;
+        for (auto& b : blocks_) {
+            std::free(b.data);
+            b.data = nullptr;
+        }
+        return error_ == 0;
+    }
+
+    int error() const { return error_; }
+    bool direct() const { return direct_; }
+
+    const char* backend() const {
+#ifdef PRIME_HAVE_LIBURING
+        if (uring_) return "io_uring";
+#endif
+        return "pwrite";
+    }
+
+private:
+    struct Block {
+        char* data = nullptr;
+        size_t len = 0;         // 在途写的长度
+        uint64_t offset = 0;    // 在途写的文件偏移
+        size_t done = 0;        // 已写完的字节数 (短写后从此处续写)
+        bool busy = false;
+    };
+
+    void submit(size_t len) {
+        Block& b = blocks_[cur_];
+        b.len = len;
+        b.offset = offset_;
+        b.done = 0;
+        offset_ += used_;
+#ifdef PRIME_HAVE_LIBURING
+        if (uring_) {
+            queue_write(b);
+            return;
+        }
+#endif
+        pwrite_all(b.data, len, b.offset);
+    }
+
+#ifdef PRIME_HAVE_LIBURING
+    // 提交块 b 中尚未写完的部分 [done, len)
+    void queue_write(Block& b) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        io_uring_prep_write(sqe, fd_, b.data + b.done, static_cast<unsigned>(b.len - b.done),
+                            b.offset + b.done);
+        io_uring_sqe_set_data(sqe, &b);
+        b.busy = true;
+        int ret = io_uring_submit(&ring_);
+        if (ret < 0) {
+            // 提交失败时同步写出，保证数据不丢
+            b.busy = false;
+            pwrite_all(b.data + b.done, b.len - b.done, b.offset + b.done);
+        }
+    }
+#endif
+
+    void next_block() {
+        cur_ = (cur_ + 1) % kBlocks;
+        used_ = 0;
+        wait(blocks_[cur_]);
+    }
+
+    // 等待某块的在途写完成 (期间顺带回收其他已完成的写)
+    void wait(Block& b) {
+#ifdef PRIME_HAVE_LIBURING
+        while (b.busy) {
+            io_uring_cqe* cqe = nullptr;
+            int ret = io_uring_wait_cqe(&ring_, &cqe);
+            if (ret == -EINTR) continue;
+            if (ret < 0) {
+                set_error(-ret);
+                for (auto& other : blocks_) other.busy = false;
+                return;
+            }
+            Block* done = static_cast<Block*>(io_uring_cqe_get_data(cqe));
+            int res = cqe->res;
+            io_uring_cqe_seen(&ring_, cqe);
+            done->busy = false;
+            if (res < 0) {
+                set_error(-res);
+            } else if (res == 0) {
+                set_error(EIO);
+            } else if (done->done + static_cast<size_t>(res) < done->len) {
+                // 短写：余下部分重新经 io_uring 提交。不能改用 pwrite 补齐——
+                // O_DIRECT 下不对齐的偏移和长度会返回 EINVAL
+                done->done += static_cast<size_t>(res);
+                queue_write(*done);
+            }
+        }
+#else
+        (void)b;
+#endif
+    }
+
+    void pwrite_all(const char* data, size_t len, uint64_t offset) {
+        while (len > 0) {
+            ssize_t n = ::pwrite(fd_, data, len, static_cast<off_t>(offset));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                set_error(errno);
+                return;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+    }
+
+    void set_error(int err) {
+        if (error_ == 0) error_ = err;
+    }
+
+    int fd_ = -1;
+    bool direct_ = false;
+    int error_ = 0;
+    Block blocks_[kBlocks];
+    unsigned cur_ = 0;
+    size_t used_ = 0;       // 当前块已填充字节数
+    uint64_t offset_ = 0;   // 当前块在文件中的偏移
+#ifdef PRIME_HAVE_LIBURING
+    io_uring ring_{};
+    bool uring_ = false;
+#endif
+};
+
+} // namespace prime_output
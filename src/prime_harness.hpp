@@ -0,0 +1,256 @@
+#pragma once
+// In-process benchmark harness for prime_bench.
+// Runs the thread-based scheduling strategies (sequence / libfork worker
+// threads / libfork fork-join) inside the benchmark process against the same
+// prime_sieve.hpp kernel, and times compute, merge, sort and write separately.
+// Seastar variants own the whole process (reactor, memory pre-allocation), so
+// they are still benchmarked as isolated child processes by prime_bench.
+
+#include <libfork/core.hpp>
+#include <libfork/schedule.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "prime_cache.hpp"
+#include "prime_output.hpp"
+#include "prime_sieve.hpp"
+
+namespace harness {
+
+// 调度策略：与 sequence_prime / minimax_libfork_prime / glm5_libfork_prime 一一对应
+enum class Strategy {
+    sequence,        // 单线程顺序执行
+    worker_threads,  // N 个 std::thread 各自 sync_wait 一个 libfork 循环协程，原子计数器分发
+    fork_join,       // libfork 递归 fork 出 N 个 worker，worker 递归 call 自身
+};
+
+struct RunConfig {
+    int num_tasks = 32;
+    int chunk_size = 100000;
+    int num_threads = 32;
+    std::string output_file;  // 为空时跳过写入阶段
+    prime_output::Format format = prime_output::Format::csv;
+};
+
+// 各阶段耗时（毫秒）
+struct PhaseTimes {
+    double compute_ms = 0.0;
+    double merge_ms = 0.0;
+    double sort_ms = 0.0;
+    double write_ms = 0.0;
+
+    double total_ms() const noexcept {
+        return compute_ms + merge_ms + sort_ms + write_ms;
+    }
+};
+
+struct RunResult {
+    size_t primes = 0;
+    PhaseTimes phases;
+    std::string error;  // 写入阶段失败时的原因；为空表示成功
+
+    bool ok() const noexcept { return error.empty(); }
+};
+
+struct TaskResult {
+    int task_id;
+    uint64_t start;
+    uint64_t end;
+    int core_id;
+    std::vector<uint64_t> primes;
+};
+
+namespace detail {
+
+constexpr int kMaxThreads = 128;
+
+struct alignas(64) PaddedResults { std::vector<TaskResult> results; };
+struct alignas(64) AlignedAtomicInt { std::atomic<int> value{0}; };
+
+// 一次运行的共享状态；libfork 协程不能捕获，所以通过指针参数传递
+struct Context {
+    int num_tasks;
+    int chunk_size;
+    prime_output::BitmapFile* bitmap = nullptr;  // bitmap 格式：计算阶段直接写文件
+    std::atomic<size_t> bitmap_primes{0};
+    AlignedAtomicInt next_task;
+    PaddedResults per_thread[kMaxThreads];
+};
+
+inline double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - since).count();
+}
+
+// 计算单个任务并存入 per-thread 结果（连续区间：第一个任务从2开始）
+inline void computeTask(Context* ctx, int task_id, int core_id) {
+    uint64_t start = (task_id == 0) ? 2 : static_cast<uint64_t>(task_id) * ctx->chunk_size;
+    uint64_t end = static_cast<uint64_t>(task_id + 1) * ctx->chunk_size;
+    if (ctx->bitmap) {
+        ctx->bitmap_primes.fetch_add(ctx->bitmap->sieve_and_write(start, end), std::memory_order_relaxed);
+        return;
+    }
+    ctx->per_thread[core_id].results.push_back(
+        TaskResult{task_id, start, end, core_id, prime_cache::sieve(start, end)});
+}
+
+// minimax_libfork_prime 策略：每个线程上的循环协程
+inline constexpr auto loopTask =
+    [](auto self, Context* ctx, int core_id) -> lf::task<void> {
+    while (true) {
+        int task_id = ctx->next_task.value.fetch_add(1, std::memory_order_relaxed);
+        if (task_id >= ctx->num_tasks) [[unlikely]] {
+            co_return;
+        }
+        computeTask(ctx, task_id, core_id);
+    }
+};
+
+// glm5_libfork_prime 策略：worker 处理一个任务后递归 call 自身
+inline constexpr auto recursiveWorker =
+    [](auto self, Context* ctx, int core_id) -> lf::task<void> {
+    int task_id = ctx->next_task.value.fetch_add(1, std::memory_order_relaxed);
+    if (task_id >= ctx->num_tasks) [[unlikely]] {
+        co_return;
+    }
+    computeTask(ctx, task_id, core_id);
+    co_await lf::call[self](ctx, core_id);
+};
+
+inline constexpr auto forkWorkers =
+    [](auto self, Context* ctx, int remaining_workers) -> lf::task<void> {
+    if (remaining_workers <= 0) [[unlikely]] {
+        co_return;
+    }
+    if (remaining_workers == 1) {
+        co_await lf::call[recursiveWorker](ctx, 0);
+        co_return;
+    }
+    co_await lf::fork[recursiveWorker](ctx, remaining_workers - 1);
+    co_await lf::call[self](ctx, remaining_workers - 1);
+    co_await lf::join;
+};
+
+// 返回错误原因，成功时为空
+inline std::string writeResults(const std::string& filename, prime_output::Format format,
+                                const std::vector<TaskResult>& results) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) [[unlikely]] {
+        return "无法打开 " + filename + ": " + std::strerror(errno);
+    }
+    std::string buffer;
+    buffer.reserve(128 * 1024);
+    prime_output::append_file_header(format, buffer);
+    for (const auto& result : results) {
+        prime_output::append_task(format, buffer, result.start, result.end, result.core_id, result.primes);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    file.close();
+    if (!file) [[unlikely]] {
+        return "写入 " + filename + " 失败";
+    }
+    return {};
+}
+
+} // namespace detail
+
+// 进程内运行一种调度策略，分阶段计时
+inline RunResult run(Strategy strategy, const RunConfig& config) {
+    using clock = std::chrono::steady_clock;
+
+    auto ctx = std::make_unique<detail::Context>();
+    ctx->num_tasks = config.num_tasks;
+    ctx->chunk_size = config.chunk_size;
+    int num_threads = std::clamp(config.num_threads, 1, detail::kMaxThreads);
+
+    RunResult result;
+
+    prime_output::BitmapFile bitmap;
+    if (config.format == prime_output::Format::bitmap && !config.output_file.empty()) {
+        if (bitmap.open(config.output_file, static_cast<uint64_t>(config.num_tasks) * config.chunk_size)) {
+            ctx->bitmap = &bitmap;
+        }
+    }
+
+    // 1. 计算阶段（含线程池创建，与各可执行程序的计时口径一致）
+    auto t0 = clock::now();
+    switch (strategy) {
+        case Strategy::sequence:
+            for (int task_id = 0; task_id < ctx->num_tasks; ++task_id) {
+                detail::computeTask(ctx.get(), task_id, 0);
+            }
+            break;
+        case Strategy::worker_threads: {
+            lf::lazy_pool pool(static_cast<size_t>(num_threads));
+            std::vector<std::thread> threads;
+            threads.reserve(num_threads);
+            for (int i = 0; i < num_threads; ++i) {
+                threads.emplace_back([&pool, ctx = ctx.get(), i] {
+                    lf::sync_wait(pool, detail::loopTask, ctx, i);
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            break;
+        }
+        case Strategy::fork_join: {
+            lf::lazy_pool pool(static_cast<size_t>(num_threads));
+            lf::sync_wait(pool, detail::forkWorkers, ctx.get(), num_threads);
+            break;
+        }
+    }
+    result.phases.compute_ms = detail::elapsed_ms(t0);
+
+    // 2. 合并 per-thread 结果
+    auto t1 = clock::now();
+    std::vector<TaskResult> all_results;
+    {
+        size_t total = 0;
+        for (const auto& slot : ctx->per_thread) total += slot.results.size();
+        all_results.reserve(total);
+        for (auto& slot : ctx->per_thread) {
+            for (auto& r : slot.results) {
+                result.primes += r.primes.size();
+                all_results.push_back(std::move(r));
+            }
+            slot.results.clear();
+        }
+    }
+    result.primes += ctx->bitmap_primes.load(std::memory_order_relaxed);
+    result.phases.merge_ms = detail::elapsed_ms(t1);
+
+    // 3. 按任务ID排序
+    auto t2 = clock::now();
+    std::sort(all_results.begin(), all_results.end(),
+              [](const TaskResult& a, const TaskResult& b) {
+                  return a.task_id < b.task_id;
+              });
+    result.phases.sort_ms = detail::elapsed_ms(t2);
+
+    // 4. 写入结果文件（bitmap 已在计算阶段写入，这里只剩 close）
+    if (ctx->bitmap) {
+        auto t3 = clock::now();
+        if (!bitmap.close()) result.error = "写入 " + config.output_file + " 失败";
+        result.phases.write_ms = detail::elapsed_ms(t3);
+    } else if (!config.output_file.empty()) {
+        auto t3 = clock::now();
+        result.error = detail::writeResults(config.output_file, config.format, all_results);
+        result.phases.write_ms = detail::elapsed_ms(t3);
+    }
+
+    return result;
+}
+
+} // namespace harness
@@ -0,0 +1,269 @@
+#pragma once
+// Range queries over csv / bin result files through their "<output>.idx"
+// sidecar (layout and IndexBuilder in prime_output.hpp).
+//
+// The index is loaded whole; a query binary-searches the first task whose
+// range reaches the lower bound and preads only the records of the tasks that
+// overlap [lo, hi), so a lookup costs O(log tasks + result size) instead of a
+// scan from the start of the file. count() answers tasks that lie entirely
+// inside the range from the stored prime counts without reading them.
+// build_index() recreates the sidecar by scanning a file written without one.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "prime_output.hpp"
+
+namespace prime_index {
+
+using prime_output::Format;
+using prime_output::IndexEntry;
+
+// 解析一行 csv 中的素数部分："<start>-<end>,<core>,p1,p2,...\n"
+inline bool parse_csv_primes(const char* p, const char* end, std::vector<uint64_t>& primes) {
+    primes.clear();
+    for (int field = 0; field < 2; ++field) {
+        while (p != end && *p != ',' && *p != '\n') ++p;
+        if (p == end || *p == '\n') return field == 1;   // 无素数的任务
+        ++p;
+    }
+    while (p != end && *p != '\n') {
+        uint64_t v = 0;
+        const char* digits = p;
+        while (p != end && *p >= '0' && *p <= '9') v = v * 10 + static_cast<uint64_t>(*p++ - '0');
+        if (p == digits) return false;
+        primes.push_back(v);
+        if (p != end && *p == ',') ++p;
+    }
+    return true;
+}
+
+class Reader {
+public:
+    Reader() = default;
+    ~Reader() { close(); }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // 打开结果文件及其索引 (默认 <path>.idx)
+    bool open(const std::string& path, const std::string& index = "") {
+        close();
+        if (!load_index(index.empty() ? prime_output::index_path(path) : index)) return false;
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            error_ = path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) {
+            error_ = path + ": " + std::strerror(errno);
+            return false;
+        }
+        if (static_cast<uint64_t>(st.st_size) != data_size_) {
+            error_ = "索引与结果文件长度不符 (索引 " + std::to_string(data_size_) + " 字节, 文件 " +
+                     std::to_string(st.st_size) + " 字节)";
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        entries_.clear();
+        bytes_read_ = 0;
+    }
+
+    // 把 [lo, hi) 内的素数按升序追加到 out
+    bool query(uint64_t lo, uint64_t hi, std::vector<uint64_t>& out) {
+        for (size_t i = first_task(lo); i < entries_.size() && entries_[i].start < hi; ++i) {
+            if (!read_task(i)) return false;
+            auto begin = std::lower_bound(primes_.begin(), primes_.end(), lo);
+            auto end = std::lower_bound(begin, primes_.end(), hi);
+            out.insert(out.end(), begin, end);
+        }
+        return true;
+    }
+
+    // [lo, hi) 内的素数个数；整个落在区间内的任务直接取索引中的计数
+    bool count(uint64_t lo, uint64_t hi, uint64_t& n) {
+        n = 0;
+        for (size_t i = first_task(lo); i < entries_.size() && entries_[i].start < hi; ++i) {
+            const IndexEntry& e = entries_[i];
+            if (e.start >= lo && e.end <= hi) {
+                n += e.count;
+                continue;
+            }
+            if (!read_task(i)) return false;
+            auto begin = std::lower_bound(primes_.begin(), primes_.end(), lo);
+            n += static_cast<uint64_t>(std::lower_bound(begin, primes_.end(), hi) - begin);
+        }
+        return true;
+    }
+
+    Format format() const { return format_; }
+    const std::vector<IndexEntry>& entries() const { return entries_; }
+    uint64_t bytes_read() const { return bytes_read_; }   // 查询累计读取的结果文件字节数
+    const std::string& error() const { return error_; }
+
+private:
+    bool load_index(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            error_ = "无法打开索引文件 " + path;
+            return false;
+        }
+        unsigned char header[prime_output::kIndexHeaderSize];
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+            std::memcmp(header, prime_output::kIndexMagic, sizeof(prime_output::kIndexMagic)) != 0) {
+            error_ = path + ": 不是 PRI1 索引文件";
+            return false;
+        }
+        format_ = prime_output::detail::get_u32(header + 4) == 1 ? Format::bin : Format::csv;
+        uint64_t n = prime_output::detail::get_u64(header + 8);
+        data_size_ = prime_output::detail::get_u64(header + 16);
+
+        in.seekg(0, std::ios::end);
+        uint64_t file_size = static_cast<uint64_t>(in.tellg());
+        if (n != (file_size - prime_output::kIndexHeaderSize) / prime_output::kIndexEntrySize ||
+            (file_size - prime_output::kIndexHeaderSize) % prime_output::kIndexEntrySize != 0) {
+            error_ = path + ": 索引条目数与文件长度不符";
+            return false;
+        }
+        in.seekg(static_cast<std::streamoff>(prime_output::kIndexHeaderSize));
+        std::vector<unsigned char> raw(n * prime_output::kIndexEntrySize);
+        if (!in.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()))) {
+            error_ = path + ": 索引条目被截断";
+            return false;
+        }
+        entries_.resize(n);
+        for (uint64_t i = 0; i < n; ++i) {
+            const unsigned char* p = raw.data() + i * prime_output::kIndexEntrySize;
+            IndexEntry& e = entries_[i];
+            e.start = prime_output::detail::get_u64(p);
+            e.end = prime_output::detail::get_u64(p + 8);
+            e.offset = prime_output::detail::get_u64(p + 16);
+            e.count = prime_output::detail::get_u64(p + 24);
+            if (e.offset > data_size_ || (i > 0 && (e.start < entries_[i - 1].end ||
+                                                    e.offset < entries_[i - 1].offset))) {
+                error_ = path + ": 索引条目 " + std::to_string(i) + " 无序或越界";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 第一个 end > lo 的任务
+    size_t first_task(uint64_t lo) const {
+        return static_cast<size_t>(std::partition_point(entries_.begin(), entries_.end(),
+            [lo](const IndexEntry& e) { return e.end <= lo; }) - entries_.begin());
+    }
+
+    // 读出并解码第 i 个任务的记录到 primes_
+    bool read_task(size_t i) {
+        const IndexEntry& e = entries_[i];
+        uint64_t next = i + 1 < entries_.size() ? entries_[i + 1].offset : data_size_;
+        buf_.resize(next - e.offset);
+        size_t done = 0;
+        while (done < buf_.size()) {
+            ssize_t n = ::pread(fd_, buf_.data() + done, buf_.size() - done,
+                                static_cast<off_t>(e.offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                error_ = n < 0 ? std::strerror(errno) : "结果文件被截断";
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        bytes_read_ += buf_.size();
+
+        bool ok;
+        if (format_ == Format::bin) {
+            const auto* p = reinterpret_cast<const unsigned char*>(buf_.data());
+            ok = buf_.size() >= prime_output::kBinRecordHeaderSize &&
+                 prime_output::detail::get_u64(p + 24) == buf_.size() - prime_output::kBinRecordHeaderSize &&
+                 prime_output::decode_payload(p + prime_output::kBinRecordHeaderSize,
+                                              buf_.size() - prime_output::kBinRecordHeaderSize,
+                                              prime_output::detail::get_u64(p),
+                                              prime_output::detail::get_u32(p + 20), primes_);
+        } else {
+            ok = parse_csv_primes(buf_.data(), buf_.data() + buf_.size(), primes_);
+        }
+        if (!ok || primes_.size() != e.count) {
+            error_ = "任务 " + std::to_string(e.start) + "-" + std::to_string(e.end) + " 的记录损坏或与索引不符";
+            return false;
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+    Format format_ = Format::csv;
+    uint64_t data_size_ = 0;
+    std::vector<IndexEntry> entries_;
+    std::vector<char> buf_;
+    std::vector<uint64_t> primes_;
+    uint64_t bytes_read_ = 0;
+    std::string error_;
+};
+
+// 顺序扫描没有索引的结果文件，重建其索引；格式按 PRB1 魔数判断
+inline bool build_index(const std::string& path, prime_output::IndexBuilder& index, Format& format,
+                        std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        error = "无法打开结果文件 " + path;
+        return false;
+    }
+    char magic[sizeof(prime_output::kBinMagic)] = {};
+    in.read(magic, sizeof(magic));
+    format = (in.gcount() == sizeof(magic) && std::memcmp(magic, prime_output::kBinMagic, sizeof(magic)) == 0)
+             ? Format::bin : Format::csv;
+    in.clear();
+
+    uint64_t offset = 0;
+    if (format == Format::bin) {
+        offset = prime_output::kBinFileHeaderSize;
+        in.seekg(static_cast<std::streamoff>(offset));
+        unsigned char header[prime_output::kBinRecordHeaderSize];
+        while (in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            uint64_t payload = prime_output::detail::get_u64(header + 24);
+            index.add(prime_output::detail::get_u64(header), prime_output::detail::get_u64(header + 8),
+                      offset, prime_output::detail::get_u32(header + 20));
+            offset += sizeof(header) + payload;
+            in.seekg(static_cast<std::streamoff>(offset));
+        }
+        if (in.gcount() != 0) {
+            error = "记录头被截断";
+            return false;
+        }
+    } else {
+        in.seekg(0);
+        std::string line;
+        while (std::getline(in, line)) {
+            uint64_t start = 0, end = 0;
+            size_t p = 0;
+            while (p < line.size() && line[p] >= '0' && line[p] <= '9') start = start * 10 + (line[p++] - '0');
+            if (p == 0 || p == line.size() || line[p] != '-') {
+                error = "第 " + std::to_string(index.size() + 1) + " 行格式错误";
+                return false;
+            }
+            while (++p < line.size() && line[p] >= '0' && line[p] <= '9') end = end * 10 + (line[p] - '0');
+            size_t commas = static_cast<size_t>(std::count(line.begin(), line.end(), ','));
+            index.add(start, end, offset, commas > 0 ? commas - 1 : 0);
+            offset += line.size() + 1;
+        }
+    }
+    index.set_data_size(offset);
+    return true;
+}
+
+} // namespace prime_index
@@ -0,0 +1,80 @@
+#pragma once
+// Fixed-size output file mapped into memory for --output-mode mmap.
+//
+// The caller knows the exact file length up front (header plus the sum of
+// every task's encoded size), so the file is sized once with ftruncate and
+// mapped MAP_SHARED; workers then format their tasks straight into disjoint
+// ranges of the mapping without any shared buffer or lock. posix_fallocate
+// reserves the blocks first so that page faults during formatting do not
+// have to allocate on the filesystem; it is best effort and its failure is
+// ignored (tmpfs and some filesystems do not support it).
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+
+namespace prime_output {
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path, uint64_t size) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            error_ = errno;
+            return false;
+        }
+        size_ = size;
+        if (size == 0) return true;
+        if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+            error_ = errno;
+            return false;
+        }
+        (void)::posix_fallocate(fd_, 0, static_cast<off_t>(size));
+        void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (addr == MAP_FAILED) {
+            error_ = errno;
+            return false;
+        }
+        data_ = static_cast<char*>(addr);
+        return true;
+    }
+
+    char* data() { return data_; }
+    uint64_t size() const { return size_; }
+
+    // 解除映射并关闭；脏页由内核回写，返回此前是否有错误
+    bool close() {
+        if (data_) {
+            if (::munmap(data_, size_) != 0) set_error(errno);
+            data_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            if (::close(fd_) != 0) set_error(errno);
+            fd_ = -1;
+        }
+        return error_ == 0;
+    }
+
+    int error() const { return error_; }
+
+private:
+    void set_error(int err) {
+        if (error_ == 0) error_ = err;
+    }
+
+    int fd_ = -1;
+    char* data_ = nullptr;
+    uint64_t size_ = 0;
+    int error_ = 0;
+};
+
+} // namespace prime_output
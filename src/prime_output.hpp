@@ -0,0 +1,684 @@
+#pragma once
+// Shared result-file encoders for the prime calculator executables.
+//
+// csv: one line per task, "<start>-<end>,<core>,p1,p2,...\n" (unchanged).
+//
+// bin: "PRB1" magic + u32 flags (0), then one record per task:
+//   u64 start | u64 end | u32 core | u32 count | u64 payload_bytes | payload
+// All integers are little-endian. The payload is a sequence of LEB128
+// unsigned varints: the first is (p0 - start); every following one is
+// (p[i] - p[i-1]) / 2, since gaps between odd primes are even. The single odd
+// gap 2 -> 3 is encoded as 0 and restored by the decoder. Half-gaps below 128
+// take one byte and every prime gap below 2^64 fits in two, so a typical
+// record is ~1 byte per prime instead of ~8-11 characters of decimal text.
+//
+// bitmap: the raw odd-only sieve, no header. Bit b of byte k is the odd
+// number 16k + 2b + 1, so a task [start, end) occupies bytes
+// [start/16, ceil(end/16)) and tasks written back to back form one file
+// covering [0, 16 * size). Task boundaries must be multiples of 16 (chunk
+// size % 16 == 0); the first task is treated as starting at 0 with 1 cleared.
+// Thread-based executables pwrite each task's sieve words straight from the
+// worker (BitmapFile); Seastar variants rebuild the bytes from the prime list
+// in their sequential writer (append_bitmap). Read with prime_bitmap.hpp.
+//
+// csv and bin writers also emit "<output>.idx" (IndexBuilder): one entry per
+// task with its start, end, byte offset and prime count, so range queries can
+// seek straight to the relevant records (prime_index.hpp, prime_query).
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "prime_file_writer.hpp"
+#include "prime_sieve.hpp"
+
+namespace prime_output {
+
+enum class Format { csv, bin, bitmap };
+
+inline constexpr char kBinMagic[4] = {'P', 'R', 'B', '1'};
+inline constexpr size_t kBinFileHeaderSize = 8;
+inline constexpr size_t kBinRecordHeaderSize = 32;
+inline constexpr uint64_t kBitmapAlign = 16;   // 每字节覆盖 16 个整数
+
+inline bool parse_format(std::string_view name, Format& format) {
+    if (name == "csv") { format = Format::csv; return true; }
+    if (name == "bin") { format = Format::bin; return true; }
+    if (name == "bitmap") { format = Format::bitmap; return true; }
+    return false;
+}
+
+inline const char* format_name(Format format) {
+    switch (format) {
+        case Format::bin: return "bin";
+        case Format::bitmap: return "bitmap";
+        case Format::csv: break;
+    }
+    return "csv";
+}
+
+// 默认输出文件名随格式切换扩展名：foo.csv -> foo.bin / foo.bitmap
+inline std::string with_extension(const std::string& path, Format format) {
+    if (format == Format::csv) return path;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+        return path.substr(0, path.size() - 4) + "." + format_name(format);
+    }
+    return path;
+}
+
+// 结果写出方式：single 计算完后合并、排序、顺序写出；sharded 各 Seastar shard
+// 按偏移并行写出 (prime_seastar_output.hpp)；stream 计算中按任务号有序流式写出；
+// mmap 算出每个任务的准确字节数后映射输出文件，各线程在前缀和偏移处原地格式化
+enum class OutputMode { single, sharded, stream, mmap };
+
+inline bool parse_output_mode(std::string_view name, OutputMode& mode) {
+    if (name == "single") { mode = OutputMode::single; return true; }
+    if (name == "sharded") { mode = OutputMode::sharded; return true; }
+    if (name == "stream") { mode = OutputMode::stream; return true; }
+    if (name == "mmap") { mode = OutputMode::mmap; return true; }
+    return false;
+}
+
+// bitmap 格式要求任务边界按 16 对齐
+inline bool bitmap_compatible(uint64_t chunk_size) {
+    return chunk_size % kBitmapAlign == 0;
+}
+
+inline uint64_t bitmap_file_size(uint64_t range_end) {
+    return (range_end + kBitmapAlign - 1) / kBitmapAlign;
+}
+
+namespace detail {
+
+inline void put_u32(std::string& out, uint32_t v) {
+    char buf[4];
+    for (int i = 0; i < 4; ++i) buf[i] = static_cast<char>(v >> (8 * i));
+    out.append(buf, 4);
+}
+
+inline void put_u64(std::string& out, uint64_t v) {
+    char buf[8];
+    for (int i = 0; i < 8; ++i) buf[i] = static_cast<char>(v >> (8 * i));
+    out.append(buf, 8);
+}
+
+inline uint64_t get_u64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+inline uint32_t get_u32(const unsigned char* p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+inline char* put_varint(char* dst, uint64_t v) {
+    while (v >= 0x80) {
+        *dst++ = static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    *dst++ = static_cast<char>(v);
+    return dst;
+}
+
+} // namespace detail
+
+// 文件头：csv 为空，bin 为魔数 + 标志位
+inline void append_file_header(Format format, std::string& out) {
+    if (format != Format::bin) return;
+    out.append(kBinMagic, sizeof(kBinMagic));
+    detail::put_u32(out, 0);
+}
+
+// 一行的最大长度：表头三个字段各至多 20 位数字加 1 个分隔符，
+// 每个素数至多 20 位加逗号；也覆盖 DecimalCursor 每次定长 20 字节的拷贝
+inline size_t csv_row_bound(size_t prime_count) {
+    return (3 + prime_count) * 21;
+}
+
+// 直接写入 [dst, limit)，返回写入末尾；limit 之后的字节不会被改写，
+// 因此 limit 取本行的准确结尾时可与相邻行并发写。
+// 素数由前一个素数加间隔得到十进制文本，不做整数除法。
+inline char* write_csv_row(char* dst, const char* limit, uint64_t start, uint64_t end, uint64_t core,
+                           const std::vector<uint64_t>& primes) {
+    char* p = util::fast_uint64_to_str(start, dst);
+    *p++ = '-';
+    p = util::fast_uint64_to_str(end, p);
+    *p++ = ',';
+    p = util::fast_uint64_to_str(core, p);
+    if (!primes.empty()) {
+        util::DecimalCursor cursor(primes[0]);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            if (i > 0) cursor.advance(primes[i] - primes[i - 1]);
+            *p++ = ',';
+            // 余量足够时定长拷贝，行尾附近按实际长度拷贝
+            p = (limit - p > static_cast<ptrdiff_t>(util::DecimalCursor::kWidth))
+                ? cursor.copy_to(p) : cursor.copy_exact(p);
+        }
+    }
+    *p++ = '\n';
+    return p;
+}
+
+// 直接写入 dst (至少 csv_row_bound 字节)，返回写入末尾
+inline char* write_csv_row(char* dst, uint64_t start, uint64_t end, uint64_t core,
+                           const std::vector<uint64_t>& primes) {
+    return write_csv_row(dst, dst + csv_row_bound(primes.size()), start, end, core, primes);
+}
+
+inline void append_csv(std::string& out, uint64_t start, uint64_t end, uint64_t core,
+                       const std::vector<uint64_t>& primes) {
+    // 按上界预留后原地格式化，再截断到实际长度
+    size_t pos = out.size();
+    out.resize(pos + csv_row_bound(primes.size()));
+    char* begin = out.data() + pos;
+    char* p = write_csv_row(begin, start, end, core, primes);
+    out.resize(pos + static_cast<size_t>(p - begin));
+}
+
+inline void append_bin(std::string& out, uint64_t start, uint64_t end, uint64_t core,
+                       const std::vector<uint64_t>& primes) {
+    size_t header_pos = out.size();
+    out.resize(header_pos + kBinRecordHeaderSize);
+    size_t payload_pos = out.size();
+
+    // 先按最坏情况（每个差值 10 字节）预留，编码后截断
+    out.resize(payload_pos + primes.size() * 10);
+    char* begin = out.data() + payload_pos;
+    char* p = begin;
+    uint64_t prev = start;
+    for (size_t i = 0; i < primes.size(); ++i) {
+        uint64_t prime = primes[i];
+        p = detail::put_varint(p, i == 0 ? prime - start : (prime - prev) >> 1);
+        prev = prime;
+    }
+    size_t payload_bytes = static_cast<size_t>(p - begin);
+    out.resize(payload_pos + payload_bytes);
+
+    std::string header;
+    header.reserve(kBinRecordHeaderSize);
+    detail::put_u64(header, start);
+    detail::put_u64(header, end);
+    detail::put_u32(header, static_cast<uint32_t>(core));
+    detail::put_u32(header, static_cast<uint32_t>(primes.size()));
+    detail::put_u64(header, payload_bytes);
+    std::memcpy(out.data() + header_pos, header.data(), kBinRecordHeaderSize);
+}
+
+// 由素数列表重建 [start/16, ceil(end/16)) 的位图字节
+inline void append_bitmap(std::string& out, uint64_t start, uint64_t end,
+                          const std::vector<uint64_t>& primes) {
+    uint64_t base = start / kBitmapAlign;
+    size_t pos = out.size();
+    out.resize(pos + (bitmap_file_size(end) - base), '\0');
+    char* bytes = out.data() + pos;
+    for (uint64_t prime : primes) {
+        if ((prime & 1) == 0) continue;   // 2 不在位图中
+        uint64_t idx = prime / 2 - base * 8;
+        bytes[idx / 8] = static_cast<char>(bytes[idx / 8] | (1u << (idx % 8)));
+    }
+}
+
+// 追加一个任务的结果
+inline void append_task(Format format, std::string& out, uint64_t start, uint64_t end,
+                        uint64_t core, const std::vector<uint64_t>& primes) {
+    switch (format) {
+        case Format::bin: append_bin(out, start, end, core, primes); break;
+        case Format::bitmap: append_bitmap(out, start, end, primes); break;
+        case Format::csv: append_csv(out, start, end, core, primes); break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 定长写出：先由位数算出每个任务编码后的准确字节数，再写入调用方给定的区间
+// ---------------------------------------------------------------------------
+
+// csv 一行的准确长度：素数升序，位数只在跨过 10 的幂时加一
+inline size_t csv_row_size(uint64_t start, uint64_t end, uint64_t core,
+                           const std::vector<uint64_t>& primes) {
+    size_t size = util::decimal_digits(start) + util::decimal_digits(end) +
+                  util::decimal_digits(core) + 3 + primes.size();
+    unsigned digits = 1;
+    uint64_t next_pow10 = 10;
+    for (uint64_t prime : primes) {
+        while (digits < 20 && prime >= next_pow10) {
+            ++digits;
+            next_pow10 *= 10;
+        }
+        size += digits;
+    }
+    return size;
+}
+
+inline size_t varint_size(uint64_t v) {
+    return v == 0 ? 1 : (static_cast<size_t>(std::bit_width(v)) + 6) / 7;
+}
+
+inline size_t bin_record_size(uint64_t start, const std::vector<uint64_t>& primes) {
+    size_t size = kBinRecordHeaderSize;
+    uint64_t prev = start;
+    for (size_t i = 0; i < primes.size(); ++i) {
+        size += varint_size(i == 0 ? primes[i] - start : (primes[i] - prev) >> 1);
+        prev = primes[i];
+    }
+    return size;
+}
+
+// bitmap 不经过此路径 (BitmapFile 按位置直写)
+inline size_t task_size(Format format, uint64_t start, uint64_t end, uint64_t core,
+                        const std::vector<uint64_t>& primes) {
+    if (format == Format::bin) return bin_record_size(start, primes);
+    return csv_row_size(start, end, core, primes);
+}
+
+// 写入 [dst, dst + size)，size 须为 task_size 的结果；不改写区间外的字节
+inline void write_task_at(Format format, char* dst, size_t size, uint64_t start, uint64_t end,
+                          uint64_t core, const std::vector<uint64_t>& primes) {
+    if (format == Format::bin) {
+        char* p = dst + kBinRecordHeaderSize;
+        uint64_t prev = start;
+        for (size_t i = 0; i < primes.size(); ++i) {
+            p = detail::put_varint(p, i == 0 ? primes[i] - start : (primes[i] - prev) >> 1);
+            prev = primes[i];
+        }
+        std::string header;
+        header.reserve(kBinRecordHeaderSize);
+        detail::put_u64(header, start);
+        detail::put_u64(header, end);
+        detail::put_u32(header, static_cast<uint32_t>(core));
+        detail::put_u32(header, static_cast<uint32_t>(primes.size()));
+        detail::put_u64(header, size - kBinRecordHeaderSize);
+        std::memcpy(dst, header.data(), kBinRecordHeaderSize);
+        return;
+    }
+    write_csv_row(dst, dst + size, start, end, core, primes);
+}
+
+// ---------------------------------------------------------------------------
+// 结果索引 (<结果文件>.idx)：每个任务一条 (start, end, 文件偏移, 素数个数)，
+// 按 start 升序。区间查询二分定位任务后只读相关记录 (prime_index.hpp)。
+// 文件头：魔数 PRI1、u32 格式 (0 csv / 1 bin)、u64 条目数、u64 结果文件长度；
+// 之后每条 4 个 u64，均为小端。bitmap 本身可按位置随机访问，不生成索引。
+// ---------------------------------------------------------------------------
+
+inline constexpr char kIndexMagic[4] = {'P', 'R', 'I', '1'};
+inline constexpr size_t kIndexHeaderSize = 24;
+inline constexpr size_t kIndexEntrySize = 32;
+
+struct IndexEntry {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t offset = 0;
+    uint64_t count = 0;
+};
+
+inline std::string index_path(const std::string& path) {
+    return path + ".idx";
+}
+
+class IndexBuilder {
+public:
+    // 按文件顺序追加
+    void add(uint64_t start, uint64_t end, uint64_t offset, uint64_t count) {
+        entries_.push_back({start, end, offset, count});
+    }
+
+    // 预先定长后按任务号填入；不同任务号可由不同线程并发填
+    void resize(size_t tasks) { entries_.assign(tasks, IndexEntry{}); }
+    void set(size_t task_id, uint64_t start, uint64_t end, uint64_t offset, uint64_t count) {
+        entries_[task_id] = {start, end, offset, count};
+    }
+
+    void set_data_size(uint64_t size) { data_size_ = size; }
+    size_t size() const { return entries_.size(); }
+
+    std::string encode(Format format) const {
+        std::string out;
+        out.reserve(kIndexHeaderSize + entries_.size() * kIndexEntrySize);
+        out.append(kIndexMagic, sizeof(kIndexMagic));
+        detail::put_u32(out, format == Format::bin ? 1 : 0);
+        detail::put_u64(out, entries_.size());
+        detail::put_u64(out, data_size_);
+        for (const auto& e : entries_) {
+            detail::put_u64(out, e.start);
+            detail::put_u64(out, e.end);
+            detail::put_u64(out, e.offset);
+            detail::put_u64(out, e.count);
+        }
+        return out;
+    }
+
+    // 写出到 path (通常为 index_path(结果文件))；bitmap 不写
+    bool write(const std::string& path, Format format) const {
+        if (format == Format::bitmap) return true;
+        std::string bytes = encode(format);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        file.close();
+        return static_cast<bool>(file);
+    }
+
+private:
+    std::vector<IndexEntry> entries_;
+    uint64_t data_size_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// bitmap 直写：预先定长的文件，工作线程各自 pwrite 自己任务的筛段
+// ---------------------------------------------------------------------------
+
+class BitmapFile {
+public:
+    BitmapFile() = default;
+    ~BitmapFile() { close(); }
+    BitmapFile(const BitmapFile&) = delete;
+    BitmapFile& operator=(const BitmapFile&) = delete;
+
+    bool open(const std::string& path, uint64_t range_end) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            error_ = errno;
+            return false;
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(bitmap_file_size(range_end))) != 0) {
+            error_ = errno;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // 筛出 [start, end) 并写到偏移 start/16，返回区间内素数个数
+    size_t sieve_and_write(uint64_t start, uint64_t end) {
+        thread_local std::vector<uint64_t> words;
+        size_t count = prime::sieve_bitmap(start, end, words);
+        uint64_t offset = start / kBitmapAlign;
+        size_t bytes = static_cast<size_t>(bitmap_file_size(end) - offset);
+        const char* data = reinterpret_cast<const char*>(words.data());
+        while (bytes > 0) {
+            ssize_t n = ::pwrite(fd_, data, bytes, static_cast<off_t>(offset));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                int expected = 0;
+                error_.compare_exchange_strong(expected, errno);
+                break;
+            }
+            data += n;
+            bytes -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return count;
+    }
+
+    // 关闭文件；返回此前是否有写入错误
+    bool close() {
+        if (fd_ >= 0) {
+            if (::close(fd_) != 0 && error_.load() == 0) error_ = errno;
+            fd_ = -1;
+        }
+        return error_.load() == 0;
+    }
+
+    int error() const { return error_.load(); }
+
+private:
+    int fd_ = -1;
+    std::atomic<int> error_{0};
+};
+
+// ---------------------------------------------------------------------------
+// 有序流式写出：工作线程各自编码，任务 N 在 0..N-1 写完后立即由写线程写出。
+// 乱序完成的任务暂存在 window 个槽位的重排缓冲中；任务号超出
+// [next, next + window) 的提交会阻塞，峰值内存为 O(window) 而非 O(范围)。
+// 任务号须从 0 连续编号且各提交一次。持有 next 的线程总能提交，不会死锁。
+// 写线程经 FileWriter (prime_file_writer.hpp) 写出：有 liburing 时用 io_uring
+// 异步提交，否则同步 pwrite；文件尽量以 O_DIRECT 打开。
+// ---------------------------------------------------------------------------
+
+class OrderedWriter {
+public:
+    OrderedWriter() = default;
+    ~OrderedWriter() { close(); }
+    OrderedWriter(const OrderedWriter&) = delete;
+    OrderedWriter& operator=(const OrderedWriter&) = delete;
+
+    bool open(const std::string& path, Format format, size_t window) {
+        if (!file_.open(path)) {
+            error_ = file_.error();
+            return false;
+        }
+        path_ = path;
+        format_ = format;
+        window_ = window > 0 ? window : 1;
+        slots_.assign(window_, Slot{});
+        next_ = 0;
+        closing_ = false;
+        peak_pending_ = 0;
+        pending_ = 0;
+        written_ = 0;
+        index_ = IndexBuilder{};
+
+        std::string header;
+        append_file_header(format, header);
+        write_all(header);
+        writer_ = std::thread([this] { writerLoop(); });
+        return true;
+    }
+
+    // 编码并提交一个任务；窗口已满时阻塞到写线程追上
+    void submit(size_t task_id, uint64_t start, uint64_t end, uint64_t core,
+                const std::vector<uint64_t>& primes) {
+        std::string bytes;
+        append_task(format_, bytes, start, end, core, primes);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [&] { return task_id < next_ + window_; });
+        Slot& slot = slots_[task_id % window_];
+        slot.bytes = std::move(bytes);
+        slot.start = start;
+        slot.end = end;
+        slot.count = primes.size();
+        slot.ready = true;
+        if (++pending_ > peak_pending_) peak_pending_ = pending_;
+        if (task_id == next_) ready_.notify_one();
+    }
+
+    // 等待全部写完并关闭；返回此前是否有写入错误
+    bool close() {
+        if (writer_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closing_ = true;
+            }
+            ready_.notify_one();
+            writer_.join();
+            if (!file_.close() && error_.load() == 0) error_ = file_.error();
+            index_.set_data_size(written_);
+            if (!index_.write(index_path(path_), format_) && error_.load() == 0) error_ = EIO;
+        }
+        return error_.load() == 0;
+    }
+
+    int error() const { return error_.load(); }
+    size_t peak_pending() const { return peak_pending_; }   // 重排缓冲最多同时暂存的任务数
+    const char* backend() const { return file_.backend(); }
+    bool direct() const { return file_.direct(); }
+
+private:
+    struct Slot {
+        std::string bytes;
+        uint64_t start = 0;
+        uint64_t end = 0;
+        uint64_t count = 0;
+        bool ready = false;
+    };
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            ready_.wait(lock, [&] { return slots_[next_ % window_].ready || closing_; });
+            if (!slots_[next_ % window_].ready) break;
+            // 取出连续就绪的任务，解锁后写出
+            std::vector<Slot> batch;
+            while (slots_[next_ % window_].ready) {
+                Slot& slot = slots_[next_ % window_];
+                batch.push_back(std::move(slot));
+                slot.bytes = std::string();
+                slot.ready = false;
+                ++next_;
+                --pending_;
+            }
+            lock.unlock();
+            space_.notify_all();
+            for (const auto& task : batch) {
+                index_.add(task.start, task.end, written_, task.count);
+                write_all(task.bytes);
+            }
+            lock.lock();
+        }
+    }
+
+    void write_all(const std::string& bytes) {
+        file_.write(bytes.data(), bytes.size());
+        written_ += bytes.size();
+    }
+
+    FileWriter file_;
+    std::string path_;
+    Format format_ = Format::csv;
+    size_t window_ = 1;
+    std::vector<Slot> slots_;
+    size_t next_ = 0;
+    size_t pending_ = 0;
+    size_t peak_pending_ = 0;
+    bool closing_ = false;
+    std::mutex mutex_;
+    std::condition_variable space_;
+    std::condition_variable ready_;
+    std::thread writer_;
+    std::atomic<int> error_{0};
+    uint64_t written_ = 0;   // 已写出字节数，仅写线程访问
+    IndexBuilder index_;     // 仅写线程访问，close() 在其结束后写出
+};
+
+// 默认重排窗口：每个工作者 4 个槽位，按批取任务时为 2 批，至少 64
+inline size_t default_reorder_window(size_t workers, size_t batch = 1) {
+    return std::max<size_t>(64, workers * std::max<size_t>(4, 2 * batch));
+}
+
+// ---------------------------------------------------------------------------
+// bin 解码
+// ---------------------------------------------------------------------------
+
+struct BinRecord {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint32_t core = 0;
+    std::vector<uint64_t> primes;
+};
+
+// 解码一条记录的负载；count 与负载不符时返回 false
+inline bool decode_payload(const unsigned char* data, size_t size, uint64_t start,
+                           uint32_t count, std::vector<uint64_t>& primes) {
+    primes.clear();
+    primes.reserve(count);
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+    uint64_t prev = start;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t v = 0;
+        int shift = 0;
+        while (true) {
+            if (p == end || shift > 63) return false;
+            unsigned char byte = *p++;
+            v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) break;
+            shift += 7;
+        }
+        uint64_t prime;
+        if (i == 0) {
+            prime = start + v;
+        } else if (prev == 2) {
+            prime = 3;
+        } else {
+            prime = prev + (v << 1);
+        }
+        primes.push_back(prime);
+        prev = prime;
+    }
+    return p == end;
+}
+
+class BinReader {
+public:
+    explicit BinReader(std::istream& in) : in_(in) {}
+
+    // 校验文件头
+    bool open() {
+        unsigned char header[kBinFileHeaderSize];
+        if (!in_.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            error_ = "文件过短，缺少文件头";
+            return false;
+        }
+        if (std::memcmp(header, kBinMagic, sizeof(kBinMagic)) != 0) {
+            error_ = "魔数不匹配，不是 PRB1 格式";
+            return false;
+        }
+        return true;
+    }
+
+    // 读取下一条记录；文件结束返回 false 且 error() 为空
+    bool next(BinRecord& record) {
+        unsigned char header[kBinRecordHeaderSize];
+        in_.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (in_.gcount() == 0) return false;
+        if (static_cast<size_t>(in_.gcount()) != sizeof(header)) {
+            error_ = "记录头被截断";
+            return false;
+        }
+        record.start = detail::get_u64(header);
+        record.end = detail::get_u64(header + 8);
+        record.core = detail::get_u32(header + 16);
+        uint32_t count = detail::get_u32(header + 20);
+        uint64_t payload_bytes = detail::get_u64(header + 24);
+
+        payload_.resize(payload_bytes);
+        if (!in_.read(reinterpret_cast<char*>(payload_.data()), static_cast<std::streamsize>(payload_bytes))) {
+            error_ = "记录负载被截断";
+            return false;
+        }
+        if (!decode_payload(payload_.data(), payload_.size(), record.start, count, record.primes)) {
+            error_ = "记录负载损坏";
+            return false;
+        }
+        ++records_;
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+    size_t records() const { return records_; }
+
+private:
+    std::istream& in_;
+    std::vector<unsigned char> payload_;
+    std::string error_;
+    size_t records_ = 0;
+};
+
+} // namespace prime_output
@@ -0,0 +1,129 @@
+// prime_query: 借助 <结果文件>.idx 索引查询 csv / bin 结果文件中 [a, b) 内的素数
+// 只读取与区间重叠的任务记录，不从头扫描结果文件
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+#include "prime_index.hpp"
+
+static void printUsage(const char* prog) {
+    std::cout << "用法: " << prog << " -i 结果文件 -a 下界 -b 上界 [-x 索引文件] [-c]" << std::endl;
+    std::cout << "      " << prog << " -i 结果文件 -r [-x 索引文件]\n" << std::endl;
+    std::cout << "参数说明:" << std::endl;
+    std::cout << "  -i <文件> csv 或 bin 结果文件" << std::endl;
+    std::cout << "  -a <N>    区间下界 (含)" << std::endl;
+    std::cout << "  -b <N>    区间上界 (不含)" << std::endl;
+    std::cout << "  -x <文件> 索引文件 (默认: <结果文件>.idx)" << std::endl;
+    std::cout << "  -c        只输出素数个数" << std::endl;
+    std::cout << "  -r        扫描结果文件重建索引 (用于没有索引的旧文件)" << std::endl;
+    std::cout << "\n示例:" << std::endl;
+    std::cout << "  " << prog << " -i sequence_prime.csv -a 1000000 -b 1000100" << std::endl;
+    std::cout << "  " << prog << " -i sequence_prime.bin -a 0 -b 100000000 -c" << std::endl;
+}
+
+static bool parseU64(const char* text, uint64_t& value) {
+    try {
+        size_t used = 0;
+        value = std::stoull(text, &used);
+        return used == std::string(text).size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string input_file;
+    std::string index_file;
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+    bool has_lo = false;
+    bool has_hi = false;
+    bool count_only = false;
+    bool rebuild = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:x:a:b:crh")) != -1) {
+        switch (opt) {
+            case 'i':
+                input_file = optarg;
+                break;
+            case 'x':
+                index_file = optarg;
+                break;
+            case 'a':
+                if (!parseU64(optarg, lo)) { std::cerr << "错误: 无效的 -a 参数" << std::endl; return 1; }
+                has_lo = true;
+                break;
+            case 'b':
+                if (!parseU64(optarg, hi)) { std::cerr << "错误: 无效的 -b 参数" << std::endl; return 1; }
+                has_hi = true;
+                break;
+            case 'c':
+                count_only = true;
+                break;
+            case 'r':
+                rebuild = true;
+                break;
+            case 'h':
+            default:
+                printUsage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (index_file.empty()) index_file = prime_output::index_path(input_file);
+
+    if (input_file.empty() || (!rebuild && (!has_lo || !has_hi))) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (rebuild) {
+        prime_output::IndexBuilder index;
+        prime_output::Format format;
+        std::string error;
+        if (!prime_index::build_index(input_file, index, format, error)) {
+            std::cerr << "错误: " << input_file << ": " << error << std::endl;
+            return 1;
+        }
+        if (!index.write(index_file, format)) {
+            std::cerr << "错误: 无法写入索引文件 " << index_file << std::endl;
+            return 1;
+        }
+        std::cerr << "已写入索引 " << index_file << ": " << index.size() << " 个任务" << std::endl;
+        return 0;
+    }
+
+    prime_index::Reader reader;
+    if (!reader.open(input_file, index_file)) {
+        std::cerr << "错误: " << reader.error() << std::endl;
+        return 1;
+    }
+
+    if (count_only) {
+        uint64_t n = 0;
+        if (!reader.count(lo, hi, n)) {
+            std::cerr << "错误: " << reader.error() << std::endl;
+            return 1;
+        }
+        std::cout << n << std::endl;
+    } else {
+        std::vector<uint64_t> primes;
+        if (!reader.query(lo, hi, primes)) {
+            std::cerr << "错误: " << reader.error() << std::endl;
+            return 1;
+        }
+        std::string out;
+        out.reserve(primes.size() * 12);
+        char buf[24];
+        for (uint64_t p : primes) {
+            out.append(buf, util::fast_uint64_to_str(p, buf));
+            out.push_back('\n');
+        }
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    }
+    std::cerr << "读取 " << reader.bytes_read() << " 字节 (结果文件共 "
+              << reader.entries().size() << " 个任务)" << std::endl;
+    return std::cout ? 0 : 1;
+}
@@ -0,0 +1,544 @@
+#pragma once
+// Sharded result writer for the Seastar prime calculators.
+//
+// The default single writer merges every shard's results onto shard 0, sorts
+// them and pushes them through one output stream, so output runs on one
+// reactor no matter how many cores computed. write_sharded() instead lets
+// every shard encode its own tasks and write them at their final offsets:
+//
+//   1. encode   each shard encodes its tasks (prime_output::append_task) into
+//               one local buffer and reports (start, length) per task;
+//               the lists are gathered on shard 0 with map_reduce.
+//   2. offsets  shard 0 sorts the tasks by start and prefix-sums the lengths
+//               after the file header, giving every task its byte offset.
+//   3. interior each shard merges tasks that are adjacent in the file into
+//               runs and dma_writes the disk-aligned interior of every run
+//               concurrently; the unaligned head/tail bytes are returned.
+//   4. edges    shard 0 assembles the blocks shared between runs (and the
+//               header) from those fragments, writes them and truncates the
+//               file to its exact size.
+//
+// The file is byte-identical to the single writer's output for all formats.
+//
+// DmaSink is the single writer's zero-copy path: CSV rows are formatted
+// straight into DMA-aligned buffers, which are submitted with dma_write when
+// full while the next buffer fills, instead of being built in a string and
+// copied into an output_stream.
+//
+// OrderedStream is the streaming alternative: workers encode each task on
+// their own shard and hand the bytes to shard 0, which writes them in task
+// order while the computation is still running. Tasks that finish early wait
+// in a reorder window of fixed size; a worker whose task is too far ahead of
+// the writer waits for space, so memory stays O(window) instead of O(range).
+//
+// Every writer also records each task's offset and emits the "<output>.idx"
+// sidecar (prime_output::IndexBuilder) next to the result file.
+
+#include <seastar/core/condition-variable.hh>
+#include <seastar/core/file.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/core/loop.hh>
+#include <seastar/core/map_reduce.hh>
+#include <seastar/core/seastar.hh>
+#include <seastar/core/semaphore.hh>
+#include <seastar/core/smp.hh>
+#include <seastar/core/temporary_buffer.hh>
+#include <seastar/core/thread.hh>
+#include <boost/range/irange.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "prime_output.hpp"
+
+namespace prime_seastar_output {
+
+// 某个 shard 编码后的全部任务；data 中按 add() 的顺序首尾相接
+struct ShardBuffer {
+    prime_output::Format format = prime_output::Format::csv;
+    std::string data;
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+    std::vector<uint64_t> counts;
+    std::vector<uint64_t> lengths;
+    std::vector<uint64_t> offsets;   // 阶段 2 由 shard 0 填入
+
+    void add(uint64_t start, uint64_t end, uint64_t core, const std::vector<uint64_t>& primes) {
+        size_t before = data.size();
+        prime_output::append_task(format, data, start, end, core, primes);
+        starts.push_back(start);
+        ends.push_back(end);
+        counts.push_back(primes.size());
+        lengths.push_back(data.size() - before);
+    }
+};
+
+namespace detail {
+
+inline constexpr size_t kWriteChunk = 1024 * 1024;   // 单次 dma_write 上限
+inline constexpr size_t kWritesInFlight = 4;         // 每个 shard 并发写数
+
+struct Extent {
+    uint64_t start;
+    uint64_t end;
+    uint64_t count;
+    uint64_t length;
+    unsigned shard;
+    size_t index;
+};
+
+// 未对齐的首尾字节，交给 shard 0 拼成完整块
+struct Fragment {
+    uint64_t offset;
+    std::string bytes;
+};
+
+struct Chunk {
+    uint64_t pos;
+    const char* data;
+    size_t len;
+};
+
+inline uint64_t align_down(uint64_t v, uint64_t align) { return v / align * align; }
+inline uint64_t align_up(uint64_t v, uint64_t align) { return align_down(v + align - 1, align); }
+
+inline std::vector<Extent> extents_of(const ShardBuffer& buf, unsigned shard) {
+    std::vector<Extent> out;
+    out.reserve(buf.starts.size());
+    for (size_t i = 0; i < buf.starts.size(); ++i) {
+        out.push_back({buf.starts[i], buf.ends[i], buf.counts[i], buf.lengths[i], shard, i});
+    }
+    return out;
+}
+
+// 复制到 DMA 对齐缓冲后写出；须在 seastar::thread 中调用
+inline void write_chunks(seastar::file& f, const std::vector<Chunk>& chunks) {
+    seastar::semaphore inflight(kWritesInFlight);
+    seastar::parallel_for_each(chunks, [&f, &inflight](const Chunk& c) {
+        return seastar::with_semaphore(inflight, 1, [&f, c] {
+            auto buf = seastar::temporary_buffer<char>::aligned(f.memory_dma_alignment(), c.len);
+            std::memcpy(buf.get_write(), c.data, c.len);
+            const char* p = buf.get();
+            return f.dma_write(c.pos, p, c.len).then([buf = std::move(buf), c](size_t written) {
+                if (written != c.len) [[unlikely]] {
+                    throw std::runtime_error("short dma_write at offset " + std::to_string(c.pos));
+                }
+            });
+        });
+    }).get();
+}
+
+// 阶段 3：写本 shard 各连续段的对齐内部，返回首尾碎片
+inline std::vector<Fragment> write_interior(const std::string& path, const ShardBuffer& buf) {
+    std::vector<Fragment> edges;
+    if (buf.lengths.empty()) return edges;
+
+    auto f = seastar::open_file_dma(path, seastar::open_flags::wo).get();
+    uint64_t align = f.disk_write_dma_alignment();
+    std::vector<Chunk> chunks;
+
+    size_t n = buf.lengths.size();
+    size_t k = 0;
+    size_t data_pos = 0;
+    while (k < n) {
+        // 文件中相邻的任务在 data 中也相邻，合并为一段
+        uint64_t run_off = buf.offsets[k];
+        uint64_t run_len = 0;
+        const char* run_data = buf.data.data() + data_pos;
+        do {
+            run_len += buf.lengths[k];
+            data_pos += buf.lengths[k];
+            ++k;
+        } while (k < n && buf.offsets[k] == run_off + run_len);
+
+        uint64_t run_end = run_off + run_len;
+        uint64_t lo = align_up(run_off, align);
+        uint64_t hi = align_down(run_end, align);
+        if (lo >= hi) {
+            edges.push_back({run_off, std::string(run_data, run_len)});
+            continue;
+        }
+        if (lo > run_off) {
+            edges.push_back({run_off, std::string(run_data, lo - run_off)});
+        }
+        if (run_end > hi) {
+            edges.push_back({hi, std::string(run_data + (hi - run_off), run_end - hi)});
+        }
+        for (uint64_t pos = lo; pos < hi; pos += kWriteChunk) {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(kWriteChunk, hi - pos));
+            chunks.push_back({pos, run_data + (pos - run_off), len});
+        }
+    }
+
+    write_chunks(f, chunks);
+    f.flush().get();
+    f.close().get();
+    return edges;
+}
+
+// 阶段 4：在 shard 0 上把碎片拼成整块写出，并截断到准确长度
+inline void write_edges(const std::string& path, std::vector<Fragment> fragments, uint64_t total) {
+    std::sort(fragments.begin(), fragments.end(),
+              [](const Fragment& a, const Fragment& b) { return a.offset < b.offset; });
+
+    auto f = seastar::open_file_dma(path, seastar::open_flags::wo).get();
+    uint64_t align = f.disk_write_dma_alignment();
+
+    struct Block {
+        uint64_t pos;
+        seastar::temporary_buffer<char> buf;
+    };
+    std::vector<Block> blocks;
+    for (const auto& frag : fragments) {
+        uint64_t off = frag.offset;
+        size_t done = 0;
+        while (done < frag.bytes.size()) {
+            uint64_t block_pos = align_down(off, align);
+            if (blocks.empty() || blocks.back().pos != block_pos) {
+                auto buf = seastar::temporary_buffer<char>::aligned(f.memory_dma_alignment(), align);
+                std::memset(buf.get_write(), 0, align);
+                blocks.push_back({block_pos, std::move(buf)});
+            }
+            size_t n = std::min<size_t>(frag.bytes.size() - done, block_pos + align - off);
+            std::memcpy(blocks.back().buf.get_write() + (off - block_pos), frag.bytes.data() + done, n);
+            done += n;
+            off += n;
+        }
+    }
+
+    std::vector<Chunk> chunks;
+    chunks.reserve(blocks.size());
+    for (const auto& b : blocks) {
+        chunks.push_back({b.pos, b.buf.get(), b.buf.size()});
+    }
+    write_chunks(f, chunks);
+    f.truncate(total).get();
+    f.flush().get();
+    f.close().get();
+}
+
+} // namespace detail
+
+// 单写者的零拷贝写出：CSV 行直接格式化进 DMA 对齐缓冲，写满后 dma_write，
+// 同时填充另一块缓冲 (双缓冲)。必须在 seastar::thread 中使用。
+class DmaSink {
+public:
+    static constexpr size_t kBufferSize = 4 * 1024 * 1024;
+
+    explicit DmaSink(seastar::file f) : file_(std::move(f)) {
+        align_ = file_.disk_write_dma_alignment();
+        for (auto& buf : bufs_) {
+            buf = seastar::temporary_buffer<char>::aligned(file_.memory_dma_alignment(), kBufferSize);
+        }
+    }
+
+    // 追加一个任务的结果；CSV 行不超过单块缓冲时原地格式化
+    void append_task(prime_output::Format format, uint64_t start, uint64_t end, uint64_t core,
+                     const std::vector<uint64_t>& primes) {
+        index_.add(start, end, offset_ + pos_, primes.size());
+        if (format == prime_output::Format::csv) {
+            size_t bound = prime_output::csv_row_bound(primes.size());
+            if (bound <= max_reserve()) {
+                char* p = reserve(bound);
+                pos_ += static_cast<size_t>(prime_output::write_csv_row(p, start, end, core, primes) - p);
+                return;
+            }
+        }
+        scratch_.clear();
+        prime_output::append_task(format, scratch_, start, end, core, primes);
+        write(scratch_.data(), scratch_.size());
+    }
+
+    void write(const char* data, size_t len) {
+        while (len > 0) {
+            size_t n = std::min(len, max_reserve());
+            std::memcpy(reserve(n), data, n);
+            pos_ += n;
+            data += n;
+            len -= n;
+        }
+    }
+
+    // 写出剩余数据，截断到准确长度并关闭文件
+    void close() {
+        uint64_t total = offset_ + pos_;
+        size_t padded = detail::align_up(pos_, align_);
+        std::memset(bufs_[cur_].get_write() + pos_, 0, padded - pos_);
+        if (padded > 0) {
+            submit(padded);
+        }
+        for (auto& w : inflight_) {
+            if (w) std::exchange(w, std::nullopt)->get();
+        }
+        file_.truncate(total).get();
+        file_.flush().get();
+        file_.close().get();
+        index_.set_data_size(total);
+    }
+
+    // append_task() 写入的各任务偏移，close() 后完整
+    const prime_output::IndexBuilder& index() const { return index_; }
+
+private:
+    // 单次可预留的上限：换块时留在原块的不足一个对齐单位的尾部会搬到新块开头
+    size_t max_reserve() const { return kBufferSize - align_; }
+
+    char* reserve(size_t n) {
+        if (pos_ + n > kBufferSize) {
+            rotate();
+        }
+        return bufs_[cur_].get_write() + pos_;
+    }
+
+    // 提交当前块的对齐部分，尾部搬到另一块 (先等它上一次的写完成)
+    void rotate() {
+        size_t full = detail::align_down(pos_, align_);
+        unsigned next = cur_ ^ 1;
+        if (inflight_[next]) {
+            std::exchange(inflight_[next], std::nullopt)->get();
+        }
+        size_t tail = pos_ - full;
+        std::memcpy(bufs_[next].get_write(), bufs_[cur_].get() + full, tail);
+        submit(full);
+        cur_ = next;
+        pos_ = tail;
+    }
+
+    void submit(size_t len) {
+        uint64_t pos = offset_;
+        // 写完成前持有缓冲的引用，出错提前析构 sink 时也不会释放仍在写的内存
+        inflight_[cur_] = file_.dma_write(pos, bufs_[cur_].get(), len)
+            .then([pos, len, hold = bufs_[cur_].share()](size_t written) {
+                if (written != len) [[unlikely]] {
+                    throw std::runtime_error("short dma_write at offset " + std::to_string(pos));
+                }
+            });
+        offset_ += len;
+    }
+
+    seastar::file file_;
+    uint64_t align_ = 4096;
+    seastar::temporary_buffer<char> bufs_[2];
+    std::optional<seastar::future<>> inflight_[2];
+    unsigned cur_ = 0;
+    size_t pos_ = 0;        // 当前块已填充字节数
+    uint64_t offset_ = 0;   // 当前块在文件中的偏移
+    std::string scratch_;   // bin/bitmap 与超大 CSV 行先编码到这里
+    prime_output::IndexBuilder index_;
+};
+
+// 写出结果文件 path 的索引 (<path>.idx)；bitmap 不写。须在 seastar::thread 中调用
+inline void write_index(const std::string& path, prime_output::Format format,
+                        const prime_output::IndexBuilder& index) {
+    if (format == prime_output::Format::bitmap) return;
+    std::string bytes = index.encode(format);
+    auto f = seastar::open_file_dma(prime_output::index_path(path),
+        seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
+    DmaSink sink(std::move(f));
+    sink.write(bytes.data(), bytes.size());
+    sink.close();
+}
+
+// 各 shard 并行写出结果文件。encode_local(ShardBuffer&) 在每个 shard 上调用，
+// 对本 shard 的每个任务调用 add()；按 start 升序添加可让更多任务合并成连续段。
+// 添加完即可释放本地结果。必须在 shard 0 上调用。
+template <typename EncodeLocal>
+seastar::future<> write_sharded(std::string path, prime_output::Format format, EncodeLocal encode_local) {
+    return seastar::async([path = std::move(path), format, encode_local = std::move(encode_local)]() mutable {
+        unsigned shards = seastar::smp::count;
+        std::vector<ShardBuffer> bufs(shards);
+
+        // 1. 各 shard 编码，(start, 长度) 清单汇总到 shard 0
+        auto extents = seastar::map_reduce(boost::irange(0u, shards),
+            [&bufs, &encode_local, format](unsigned s) {
+                return seastar::smp::submit_to(s, [&bufs, &encode_local, format, s] {
+                    bufs[s].format = format;
+                    encode_local(bufs[s]);
+                    bufs[s].offsets.resize(bufs[s].starts.size());
+                    return detail::extents_of(bufs[s], s);
+                });
+            },
+            std::vector<detail::Extent>{},
+            [](std::vector<detail::Extent> acc, std::vector<detail::Extent> part) {
+                acc.insert(acc.end(), part.begin(), part.end());
+                return acc;
+            }).get();
+
+        // 2. 按 start 排序后前缀和得到每个任务的文件偏移，同时即为索引
+        std::sort(extents.begin(), extents.end(),
+                  [](const detail::Extent& a, const detail::Extent& b) { return a.start < b.start; });
+        std::string header;
+        prime_output::append_file_header(format, header);
+        prime_output::IndexBuilder index;
+        uint64_t total = header.size();
+        for (const auto& e : extents) {
+            bufs[e.shard].offsets[e.index] = total;
+            index.add(e.start, e.end, total, e.count);
+            total += e.length;
+        }
+        index.set_data_size(total);
+
+        auto f = seastar::open_file_dma(path,
+            seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
+        f.close().get();
+
+        // 3. 各 shard 并发写对齐内部，碎片汇总到 shard 0
+        auto fragments = seastar::map_reduce(boost::irange(0u, shards),
+            [&bufs, &path](unsigned s) {
+                return seastar::smp::submit_to(s, [&bufs, &path, s] {
+                    return seastar::async([&bufs, &path, s] {
+                        auto edges = detail::write_interior(path, bufs[s]);
+                        bufs[s] = ShardBuffer{};   // 在所属 shard 上释放
+                        return edges;
+                    });
+                });
+            },
+            std::vector<detail::Fragment>{},
+            [](std::vector<detail::Fragment> acc, std::vector<detail::Fragment> part) {
+                for (auto& frag : part) acc.push_back(std::move(frag));
+                return acc;
+            }).get();
+
+        // 4. 文件头与段间共享块
+        if (!header.empty()) {
+            fragments.push_back({0, std::move(header)});
+        }
+        detail::write_edges(path, std::move(fragments), total);
+        write_index(path, format, index);
+    });
+}
+
+// 按任务号有序流式写出；对象及其全部调用都在 shard 0 上
+class OrderedStream {
+public:
+    seastar::future<> open(std::string path, prime_output::Format format, size_t window) {
+        path_ = path;
+        format_ = format;
+        window_ = window > 0 ? window : 1;
+        slots_.assign(window_, Slot{});
+        return seastar::open_file_dma(path,
+            seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate
+        ).then([this](seastar::file f) {
+            seastar::file_output_stream_options opts;
+            opts.buffer_size = 4 * 1024 * 1024;
+            return seastar::make_file_output_stream(std::move(f), opts);
+        }).then([this](seastar::output_stream<char> out) {
+            out_.emplace(std::move(out));
+            std::string header;
+            prime_output::append_file_header(format_, header);
+            written_ = header.size();
+            return out_->write(header.data(), header.size());
+        });
+    }
+
+    // 暂存一个已编码的任务；task_id 超出窗口时等待写出追上
+    seastar::future<> push(size_t task_id, uint64_t start, uint64_t end, uint64_t count, std::string bytes) {
+        return space_.wait([this, task_id] { return error_ || task_id < next_ + window_; })
+            .then([this, task_id, start, end, count, bytes = std::move(bytes)]() mutable {
+                if (error_) return;   // 写出已失败，close() 时报告
+                Slot& slot = slots_[task_id % window_];
+                slot.bytes = std::move(bytes);
+                slot.start = start;
+                slot.end = end;
+                slot.count = count;
+                slot.ready = true;
+                if (++pending_ > peak_pending_) peak_pending_ = pending_;
+                if (!writing_ && task_id == next_) {
+                    writing_ = true;
+                    writer_ = drain();
+                }
+            });
+    }
+
+    // 等待已就绪的任务写完后关闭文件；写出错误在此抛出
+    seastar::future<> close() {
+        auto writer = std::move(writer_);
+        writer_ = seastar::make_ready_future<>();
+        return writer.then([this] {
+            if (error_) return seastar::make_exception_future<>(error_);
+            if (pending_ != 0) {
+                return seastar::make_exception_future<>(std::runtime_error(
+                    "ordered stream closed with " + std::to_string(pending_) + " tasks pending"));
+            }
+            return out_->flush().then([this] {
+                return out_->close();
+            }).then([this] {
+                index_.set_data_size(written_);
+                return seastar::async([this] { write_index(path_, format_, index_); });
+            });
+        });
+    }
+
+    prime_output::Format format() const { return format_; }
+    size_t peak_pending() const { return peak_pending_; }   // 重排缓冲最多同时暂存的任务数
+
+private:
+    struct Slot {
+        std::string bytes;
+        uint64_t start = 0;
+        uint64_t end = 0;
+        uint64_t count = 0;
+        bool ready = false;
+    };
+
+    // 依次写出从 next_ 起连续就绪的任务，写完一个即腾出窗口
+    seastar::future<> drain() {
+        return seastar::repeat([this] {
+            Slot& slot = slots_[next_ % window_];
+            if (!slot.ready) {
+                writing_ = false;
+                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+            }
+            index_.add(slot.start, slot.end, written_, slot.count);
+            written_ += slot.bytes.size();
+            return out_->write(slot.bytes.data(), slot.bytes.size()).then([this, &slot] {
+                slot.bytes = std::string();
+                slot.ready = false;
+                ++next_;
+                --pending_;
+                space_.broadcast();
+                return seastar::stop_iteration::no;
+            });
+        }).handle_exception([this](std::exception_ptr ep) {
+            error_ = ep;
+            writing_ = false;
+            space_.broadcast();
+        });
+    }
+
+    std::string path_;
+    prime_output::Format format_ = prime_output::Format::csv;
+    size_t window_ = 1;
+    std::vector<Slot> slots_;
+    uint64_t written_ = 0;
+    prime_output::IndexBuilder index_;
+    size_t next_ = 0;
+    size_t pending_ = 0;
+    size_t peak_pending_ = 0;
+    bool writing_ = false;
+    std::exception_ptr error_;
+    std::optional<seastar::output_stream<char>> out_;
+    seastar::future<> writer_ = seastar::make_ready_future<>();
+    seastar::condition_variable space_;
+};
+
+// 在当前 shard 编码任务，再交给 shard 0 上的 stream 按序写出
+inline seastar::future<> submit_ordered(OrderedStream* stream, size_t task_id, uint64_t start, uint64_t end,
+                                        uint64_t core, const std::vector<uint64_t>& primes) {
+    std::string bytes;
+    prime_output::append_task(stream->format(), bytes, start, end, core, primes);
+    uint64_t count = primes.size();
+    return seastar::smp::submit_to(0, [stream, task_id, start, end, count, bytes = std::move(bytes)]() mutable {
+        return stream->push(task_id, start, end, count, std::move(bytes));
+    });
+}
+
+} // namespace prime_seastar_output
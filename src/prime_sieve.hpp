@@ -2,6 +2,7 @@
 // Shared segmented prime sieve implementation.
 // All prime calculator executables include this to avoid code duplication.
 
+#include <array>
 #include <cstdint>
 #include <vector>
 #include <cmath>
@@ -9,18 +10,11 @@
 
 namespace prime {
 
-// Segmented sieve of Eratosthenes: O(n log log n).
-// Returns all primes in the half-open interval [start, end).
-// Bit-packed odd-only sieve: 1 bit per odd number → 16x less memory.
-// Word-level marking reduces read-modify-write operations.
-// Thread-local caching minimizes allocation on hot paths.
-inline std::vector<uint64_t> segmented_sieve(uint64_t start, uint64_t end) {
-    if (end <= 2) [[unlikely]] return {};
-    if (start < 2) start = 2;
+namespace detail {
 
-    uint64_t limit = static_cast<uint64_t>(std::sqrt(static_cast<double>(end))) + 1;
-
-    // Thread-local cache for small primes — only rebuilds when limit changes.
+// Base primes up to `limit` (inclusive), including 2.
+// Thread-local cache — only rebuilds when limit changes.
+inline const std::vector<uint64_t>& small_primes(uint64_t limit) {
     thread_local uint64_t cached_limit = 0;
     thread_local std::vector<uint64_t> cached_small_primes;
 
@@ -63,30 +57,24 @@ inline std::vector<uint64_t> segmented_sieve(uint64_t start, uint64_t end) {
 
         cached_limit = limit;
     }
+    return cached_small_primes;
+}
 
-    // Segment sieve: bit-packed, odd-only
-    // first_odd = first odd number >= start
-    // bit index b represents odd number (first_odd + 2*b)
-    uint64_t first_odd = start | 1;
-    size_t odd_bits = (end > first_odd) ? (end - first_odd + 1) / 2 : 0;
-
-    if (odd_bits == 0) [[unlikely]] {
-        std::vector<uint64_t> result;
-        if (start == 2) result.push_back(2);
-        return result;
-    }
-
-    thread_local std::vector<uint64_t> seg;
-    size_t seg_words = (odd_bits + 63) / 64;
-    seg.assign(seg_words, ~0ULL);
-
-    // Word-level marking: accumulate mask per word, apply once
-    for (uint64_t p : cached_small_primes) {
+// Clear composite bits of an odd-only segment: bit b represents the odd
+// number (first_odd + 2*b), b < odd_bits, all below `end`.
+// Marking starts at max(p*p, first odd multiple >= first_odd): smaller
+// multiples have a smaller prime factor and are already cleared, and p itself
+// is never touched, so segments that contain their own base primes are safe.
+// Word-level marking: accumulate mask per word, apply once.
+inline void mark_odd_composites(uint64_t* seg, uint64_t first_odd, size_t odd_bits, uint64_t end) {
+    uint64_t limit = static_cast<uint64_t>(std::sqrt(static_cast<double>(end))) + 1;
+    for (uint64_t p : small_primes(limit)) {
         if (p == 2) continue;
+        uint64_t pp = p * p;
+        if (pp >= end) break;
 
-        uint64_t first = ((start + p - 1) / p) * p;
-        if (first == p) first += p;
-        if (first >= end) continue;
+        uint64_t first = ((first_odd + p - 1) / p) * p;
+        if (first < pp) first = pp;
         if ((first & 1) == 0) first += p;
         if (first >= end) continue;
 
@@ -106,6 +94,36 @@ inline std::vector<uint64_t> segmented_sieve(uint64_t start, uint64_t end) {
         }
         seg[cur_word] &= ~mask;
     }
+}
+
+} // namespace detail
+
+// Segmented sieve of Eratosthenes: O(n log log n).
+// Returns all primes in the half-open interval [start, end).
+// Bit-packed odd-only sieve: 1 bit per odd number → 16x less memory.
+// Word-level marking reduces read-modify-write operations.
+// Thread-local caching minimizes allocation on hot paths.
+inline std::vector<uint64_t> segmented_sieve(uint64_t start, uint64_t end) {
+    if (end <= 2) [[unlikely]] return {};
+    if (start < 2) start = 2;
+
+    // Segment sieve: bit-packed, odd-only
+    // first_odd = first odd number >= start
+    // bit index b represents odd number (first_odd + 2*b)
+    uint64_t first_odd = start | 1;
+    size_t odd_bits = (end > first_odd) ? (end - first_odd + 1) / 2 : 0;
+
+    if (odd_bits == 0) [[unlikely]] {
+        std::vector<uint64_t> result;
+        if (start == 2) result.push_back(2);
+        return result;
+    }
+
+    thread_local std::vector<uint64_t> seg;
+    size_t seg_words = (odd_bits + 63) / 64;
+    seg.assign(seg_words, ~0ULL);
+
+    detail::mark_odd_composites(seg.data(), first_odd, odd_bits, end);
 
     // Collect primes: scan words with ctz for fast bit extraction
     std::vector<uint64_t> result;
@@ -131,30 +149,139 @@ inline std::vector<uint64_t> segmented_sieve(uint64_t start, uint64_t end) {
     return result;
 }
 
+// Raw odd-only bitmap of [start, end) without extracting primes.
+// `start` is rounded down to a multiple of 16, so bit b of the little-endian
+// words represents the odd number (start + 2*b + 1) and byte k covers
+// [start + 16k, start + 16k + 16) — the on-disk layout of --format=bitmap.
+// 1 is cleared, bits at or beyond `end` are zero, 2 is not represented.
+// Returns the number of primes in [start, end), counting 2 when covered.
+inline size_t sieve_bitmap(uint64_t start, uint64_t end, std::vector<uint64_t>& words) {
+    start &= ~uint64_t{15};
+    words.clear();
+    if (end <= start) [[unlikely]] return 0;
+
+    uint64_t first_odd = start + 1;
+    size_t odd_bits = (end - start) / 2;
+    size_t seg_words = (odd_bits + 63) / 64;
+    words.assign(seg_words, ~0ULL);
+    if (seg_words == 0) [[unlikely]] return (start <= 2 && end > 2) ? 1 : 0;
+    if (odd_bits % 64 != 0) {
+        words.back() = (1ULL << (odd_bits % 64)) - 1;
+    }
+    if (start == 0) {
+        words[0] &= ~1ULL;  // 1 is not prime
+    }
+
+    detail::mark_odd_composites(words.data(), first_odd, odd_bits, end);
+
+    size_t count = (start <= 2 && end > 2) ? 1 : 0;
+    for (uint64_t w : words) {
+        count += static_cast<size_t>(__builtin_popcountll(w));
+    }
+    return count;
+}
+
 } // namespace prime
 
 namespace util {
 
+// "00".."99": two ASCII digits per entry, so one lookup emits two digits.
+inline constexpr auto kDigitPairs = [] {
+    std::array<char, 200> table{};
+    for (int i = 0; i < 100; ++i) {
+        table[2 * i] = static_cast<char>('0' + i / 10);
+        table[2 * i + 1] = static_cast<char>('0' + i % 10);
+    }
+    return table;
+}();
+
+// Number of decimal digits in `value` (1 for 0).
+inline unsigned decimal_digits(uint64_t value) noexcept {
+    unsigned n = 1;
+    while (value >= 10000) {
+        value /= 10000;
+        n += 4;
+    }
+    if (value >= 1000) return n + 3;
+    if (value >= 100) return n + 2;
+    if (value >= 10) return n + 1;
+    return n;
+}
+
+// Writes exactly `digits` characters of `value`, back to front, two at a time.
+inline void write_decimal(uint64_t value, char* buffer, unsigned digits) noexcept {
+    char* p = buffer + digits;
+    while (value >= 100) {
+        unsigned pair = static_cast<unsigned>(value % 100);
+        value /= 100;
+        p -= 2;
+        std::memcpy(p, &kDigitPairs[2 * pair], 2);
+    }
+    if (value >= 10) {
+        std::memcpy(p - 2, &kDigitPairs[2 * value], 2);
+    } else {
+        p[-1] = static_cast<char>('0' + value);
+    }
+}
+
 // Fast uint64-to-string — no allocation, writes directly to buffer.
 // Returns pointer past the last written character.
 inline char* fast_uint64_to_str(uint64_t value, char* buffer) noexcept {
-    if (value == 0) [[unlikely]] {
-        *buffer++ = '0';
-        return buffer;
-    }
-    char* end = buffer;
-    while (value > 0) {
-        *end++ = '0' + static_cast<char>(value % 10);
-        value /= 10;
-    }
-    char* first = buffer;
-    char* last = end - 1;
-    while (first < last) {
-        char tmp = *first;
-        *first++ = *last;
-        *last-- = tmp;
-    }
-    return end;
+    unsigned digits = decimal_digits(value);
+    write_decimal(value, buffer, digits);
+    return buffer + digits;
 }
 
+// Decimal text of an increasing sequence, updated by delta. Consecutive
+// primes share all but their last few digits, so adding the gap to the
+// ASCII digits touches only the tail (plus any carry) instead of
+// re-dividing the whole number.
+class DecimalCursor {
+public:
+    explicit DecimalCursor(uint64_t value) noexcept {
+        std::memset(digits_, '0', sizeof(digits_));
+        len_ = decimal_digits(value);
+        write_decimal(value, digits_ + kWidth - len_, len_);
+    }
+
+    void advance(uint64_t delta) noexcept {
+        char* p = digits_ + kWidth;
+        while (delta != 0) {
+            --p;
+            unsigned d = static_cast<unsigned>(*p - '0') + static_cast<unsigned>(delta % 10);
+            delta /= 10;
+            if (d >= 10) {
+                d -= 10;
+                ++delta;
+            }
+            *p = static_cast<char>('0' + d);
+        }
+        unsigned touched = static_cast<unsigned>(digits_ + kWidth - p);
+        if (touched > len_) len_ = touched;
+    }
+
+    const char* data() const noexcept { return digits_ + kWidth - len_; }
+    unsigned size() const noexcept { return len_; }
+
+    // Copies the digits to `out`, which must have room for kWidth bytes:
+    // a fixed-size copy avoids a variable-length memcpy call per number.
+    // Returns pointer past the last digit.
+    char* copy_to(char* out) const noexcept {
+        std::memcpy(out, data(), kWidth);
+        return out + len_;
+    }
+
+    // Copies exactly size() bytes to `out`.
+    char* copy_exact(char* out) const noexcept {
+        std::memcpy(out, data(), len_);
+        return out + len_;
+    }
+
+    static constexpr unsigned kWidth = 20;   // digits of UINT64_MAX
+
+private:
+    char digits_[2 * kWidth];   // right-aligned in the first kWidth bytes
+    unsigned len_;
+};
+
 } // namespace util
@@ -6,11 +6,14 @@
 #include <atomic>
 #include <chrono>
 #include <string>
+#include <cstring>
 
 #include <iomanip>
 #include <algorithm>
 #include <getopt.h>
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_cache.hpp"
 
 // ============================================================================
 // 全局配置
@@ -20,6 +23,7 @@ struct Config {
     int chunk_size = 100000;  // 每个任务的区间大小
     int num_threads = 1;      // 使用线程数（顺序执行，默认为1）
     std::string output_file = "sequence_prime.csv";  // 输出文件路径
+    prime_output::Format format = prime_output::Format::csv;  // 输出格式
 };
 
 Config g_config;
@@ -41,6 +45,8 @@ struct TaskResult {
 std::vector<TaskResult> g_results;
 std::atomic<int> g_completed_tasks{0};
 std::atomic<uint64_t> g_total_primes{0};
+prime_output::BitmapFile* g_bitmap = nullptr;  // bitmap 格式：计算时直接写入文件
+prime_output::OrderedWriter* g_stream = nullptr;  // stream 模式：计算时按任务号流式写出
 
 // ============================================================================
 // 功能函数：初始化任务队列
@@ -69,10 +75,10 @@ void initTaskQueue(int num_tasks, int chunk_size, int num_threads) {
 }
 
 // ============================================================================
-// 功能函数：输出计算结果到CSV文件
+// 功能函数：输出计算结果到文件（CSV 或二进制）
 // ============================================================================
 void outputResults(const std::string& filename) {
-    std::ofstream file(filename);
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
     if (!file.is_open()) {
         std::cerr << "错误: 无法打开输出文件 " << filename << std::endl;
         return;
@@ -86,20 +92,26 @@ void outputResults(const std::string& filename) {
                   return a.task_id < b.task_id;
               });
 
-    // 写入CSV
+    // 逐任务编码后写入，同时记录每个任务的偏移作为索引
+    std::string buffer;
+    buffer.reserve(128 * 1024);
+    prime_output::append_file_header(g_config.format, buffer);
+    prime_output::IndexBuilder index;
+    uint64_t offset = 0;
     for (const auto& result : g_results) {
-        // 第一字段：任务范围
-        file << result.start << "-" << result.end;
-        // 第二字段：CPU核编号
-        file << "," << result.core_id;
-        // 后续字段：素数列表
-        for (uint64_t prime : result.primes) {
-            file << "," << prime;
-        }
-        file << "\n";
+        index.add(result.start, result.end, offset + buffer.size(), result.primes.size());
+        prime_output::append_task(g_config.format, buffer, result.start, result.end,
+                                  result.core_id, result.primes);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        offset += buffer.size();
+        buffer.clear();
     }
 
     file.close();
+    index.set_data_size(offset);
+    if (!index.write(prime_output::index_path(filename), g_config.format)) {
+        std::cerr << "警告: 无法写入索引文件 " << prime_output::index_path(filename) << std::endl;
+    }
     std::cout << "结果已写入: " << filename << std::endl;
 }
 
@@ -141,10 +153,26 @@ void sequentialCompute() {
         uint64_t start = (task_id == 0) ? 2 : static_cast<uint64_t>(task_id) * g_config.chunk_size;
         uint64_t end = static_cast<uint64_t>(task_id + 1) * g_config.chunk_size;
 
+        // bitmap 格式：筛段直接写入文件，不提取素数
+        if (g_bitmap) {
+            size_t count = g_bitmap->sieve_and_write(start, end);
+            g_completed_tasks.fetch_add(1);
+            g_total_primes.fetch_add(count);
+            continue;
+        }
+
         // 计算该区间的素数
-        std::vector<uint64_t> primes = prime::segmented_sieve(start, end);
+        std::vector<uint64_t> primes = prime_cache::sieve(start, end);
         size_t count = primes.size();
 
+        // stream 模式：交给写线程，不保留结果
+        if (g_stream) {
+            g_stream->submit(task_id, start, end, 0, primes);
+            g_completed_tasks.fetch_add(1);
+            g_total_primes.fetch_add(count);
+            continue;
+        }
+
         // 收集结果
         TaskResult result;
         result.task_id = task_id;
@@ -168,11 +196,24 @@ int main(int argc, char** argv) {
     int num_tasks = 1;
     int chunk_size = 100000;
     int num_threads = 1;
-    std::string output_file = "sequence_prime.csv";
+    std::string output_file;
+    prime_output::Format format = prime_output::Format::csv;
+    prime_output::OutputMode mode = prime_output::OutputMode::stream;
+    std::string cache_dir;
+
+    constexpr int kOptOutputMode = 256;
+    constexpr int kOptCacheDir = 257;
+    static const option long_options[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {"output-mode", required_argument, nullptr, kOptOutputMode},
+        {"cache-dir", required_argument, nullptr, kOptCacheDir},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
 
     // 解析命令行参数
     int opt;
-    while ((opt = getopt(argc, argv, "t:n:c:o:h")) != -1) {
+    while ((opt = getopt_long(argc, argv, "t:n:c:o:f:h", long_options, nullptr)) != -1) {
         switch (opt) {
             case 't':
                 num_tasks = std::atoi(optarg);
@@ -186,14 +227,33 @@ int main(int argc, char** argv) {
             case 'o':
                 output_file = optarg;
                 break;
+            case 'f':
+                if (!prime_output::parse_format(optarg, format)) {
+                    std::cerr << "错误: 无效的输出格式 " << optarg << " (可选: csv, bin, bitmap)" << std::endl;
+                    return 1;
+                }
+                break;
+            case kOptOutputMode:
+                if (!prime_output::parse_output_mode(optarg, mode) || mode == prime_output::OutputMode::sharded ||
+                    mode == prime_output::OutputMode::mmap) {
+                    std::cerr << "错误: 无效的输出模式 " << optarg << " (可选: stream, single)" << std::endl;
+                    return 1;
+                }
+                break;
+            case kOptCacheDir:
+                cache_dir = optarg;
+                break;
             case 'h':
             default:
-                std::cout << "用法: " << argv[0] << " [-t 任务数] [-n 区间大小] [-c 线程数] [-o 输出文件]\n" << std::endl;
+                std::cout << "用法: " << argv[0] << " [-t 任务数] [-n 区间大小] [-c 线程数] [-o 输出文件] [-f csv|bin|bitmap] [--output-mode stream|single] [--cache-dir 目录]\n" << std::endl;
                 std::cout << "参数说明:" << std::endl;
                 std::cout << "  -t <N>   任务总数 (默认: 1)" << std::endl;
                 std::cout << "  -n <N>   区间大小，每任务计算的数字范围 (默认: 100000，最大: 100000)" << std::endl;
                 std::cout << "  -c <N>   线程数 (默认: 1，顺序执行)" << std::endl;
-                std::cout << "  -o <文件> 输出CSV文件路径 (默认: sequence_prime.csv)" << std::endl;
+                std::cout << "  -o <文件> 输出文件路径 (默认: sequence_prime.csv，bin 格式为 sequence_prime.bin)" << std::endl;
+                std::cout << "  -f, --format <F> 输出格式: csv、bin 或 bitmap (默认: csv，bitmap 要求区间大小为 16 的倍数)" << std::endl;
+                std::cout << "  --output-mode <M> stream: 计算中按任务号有序流式写出 (默认); single: 算完后排序统一写出" << std::endl;
+                std::cout << "  --cache-dir <D> 持久素数缓存目录：已缓存的区间直接 mmap 读取，其余筛完后写入 (默认不启用)" << std::endl;
                 std::cout << "\n示例:" << std::endl;
                 std::cout << "  " << argv[0] << " -t 1 -n 100000 -c 1 -o ./output/sequence_primes.csv" << std::endl;
                 std::cout << "  " << argv[0] << " -t 10 -n 100000 -c 1 -o ./output/sequence_primes.csv" << std::endl;
@@ -205,16 +265,51 @@ int main(int argc, char** argv) {
     if (num_tasks <= 0) num_tasks = 1;
     if (chunk_size <= 0) chunk_size = 100000;
     if (num_threads <= 0) num_threads = 1;
+    if (output_file.empty()) {
+        output_file = prime_output::with_extension("sequence_prime.csv", format);
+    }
+    if (format == prime_output::Format::bitmap && !prime_output::bitmap_compatible(chunk_size)) {
+        std::cerr << "错误: bitmap 格式要求区间大小为 16 的倍数" << std::endl;
+        return 1;
+    }
 
     // 更新全局配置
     g_config.num_tasks = num_tasks;
     g_config.chunk_size = chunk_size;
     g_config.num_threads = num_threads;
     g_config.output_file = output_file;
+    g_config.format = format;
 
     // 1. 初始化任务队列
     initTaskQueue(num_tasks, chunk_size, num_threads);
 
+    // 缓存目录先于输出文件校验，无效时不留下被截断的空结果文件
+    prime_cache::Cache cache;
+    if (!cache_dir.empty()) {
+        if (!cache.open(cache_dir)) {
+            std::cerr << "错误: 无法使用缓存目录 " << cache.error() << std::endl;
+            return 1;
+        }
+        prime_cache::install(&cache);
+    }
+
+    prime_output::BitmapFile bitmap;
+    if (format == prime_output::Format::bitmap) {
+        if (!bitmap.open(output_file, static_cast<uint64_t>(num_tasks) * chunk_size)) {
+            std::cerr << "错误: 无法打开输出文件 " << output_file << ": " << std::strerror(bitmap.error()) << std::endl;
+            return 1;
+        }
+        g_bitmap = &bitmap;
+    }
+    prime_output::OrderedWriter stream;
+    if (format != prime_output::Format::bitmap && mode == prime_output::OutputMode::stream) {
+        if (!stream.open(output_file, format, prime_output::default_reorder_window(1))) {
+            std::cerr << "错误: 无法打开输出文件 " << output_file << ": " << std::strerror(stream.error()) << std::endl;
+            return 1;
+        }
+        g_stream = &stream;
+    }
+
     // 2. 记录开始时间
     auto start_time = std::chrono::high_resolution_clock::now();
 
@@ -228,8 +323,28 @@ int main(int argc, char** argv) {
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-    // 5. 输出结果到CSV文件
-    outputResults(g_config.output_file);
+    // 5. 输出结果到文件（bitmap 与 stream 已在计算时写入）
+    if (g_bitmap) {
+        if (!bitmap.close()) {
+            std::cerr << "错误: 写入 " << output_file << " 失败: " << std::strerror(bitmap.error()) << std::endl;
+            return 1;
+        }
+        std::cout << "\n结果已写入: " << output_file << std::endl;
+    } else if (g_stream) {
+        if (!stream.close()) {
+            std::cerr << "错误: 写入 " << output_file << " 失败: " << std::strerror(stream.error()) << std::endl;
+            return 1;
+        }
+        std::cout << "\n结果已写入: " << output_file << " (重排缓冲峰值 " << stream.peak_pending() << " 个任务, "
+                  << stream.backend() << (stream.direct() ? " + O_DIRECT" : "") << ")" << std::endl;
+    } else {
+        outputResults(g_config.output_file);
+    }
+
+    if (!cache_dir.empty()) {
+        std::cout << "素数缓存: 命中 " << cache.hits() << " 块, 新筛 " << cache.misses() << " 块 ("
+                  << cache_dir << ")" << std::endl;
+    }
 
     // 6. 打印统计结果
     printStatistics(duration.count());
@@ -26,6 +26,9 @@
 #include <memory>
 
 #include "prime_sieve.hpp"
+#include "prime_output.hpp"
+#include "prime_seastar_output.hpp"
+#include "prime_cache.hpp"
 
 static seastar::logger applog("seastar_prime");
 
@@ -59,58 +62,101 @@ static AlignedAtomicSize g_total_tasks;
 // C2: per-core result vectors — no mutex needed, each core writes its own slot
 // ---------------------------------------------------------------------------
 constexpr size_t kMaxCores = 128;
-struct alignas(64) PaddedResults { std::vector<TaskResult> results; };
+struct alignas(64) PaddedResults {
+    std::vector<TaskResult> results;
+    size_t streamed_tasks = 0;    // tasks already handed to the ordered stream
+    size_t streamed_primes = 0;
+};
 static PaddedResults g_results_per_core[kMaxCores];
 
+// Stream mode: ordered writer owned by core 0; null in the other modes
+static std::unique_ptr<prime_seastar_output::OrderedStream> g_stream;
+static std::unique_ptr<prime_cache::Cache> g_cache;   // --cache-dir; shared by all shards
+
 // ---------------------------------------------------------------------------
-// CSV output using util::fast_uint64_to_str — no stringstream allocation
+// Result output (CSV or PRB1 binary) via prime_output.hpp — no stringstream allocation
 // ---------------------------------------------------------------------------
-static seastar::future<> write_results_csv_async(const std::string& path,
-                                                 std::vector<TaskResult> results) {
+static seastar::future<> write_results_async(const std::string& path, prime_output::Format format,
+                                             std::vector<TaskResult> results) {
     // Sort by task start so rows appear in ascending numeric order
     std::sort(results.begin(), results.end(),
               [](const TaskResult& a, const TaskResult& b) {
                   return a.start < b.start;
               });
 
-    return seastar::async([path, results = std::move(results)]() mutable {
+    return seastar::async([path, format, results = std::move(results)]() mutable {
         auto f = seastar::open_file_dma(path,
             seastar::open_flags::wo | seastar::open_flags::create | seastar::open_flags::truncate).get();
-        seastar::file_output_stream_options opts;
-        opts.buffer_size = 4 * 1024 * 1024;
-        auto out = seastar::make_file_output_stream(std::move(f), opts).get();
-        char tmp[21];
-        std::string line;
-        line.reserve(128 * 1024);
+        // Rows are formatted straight into DMA buffers; one dma_write per filled buffer
+        prime_seastar_output::DmaSink sink(std::move(f));
+        std::string header;
+        prime_output::append_file_header(format, header);
+        sink.write(header.data(), header.size());
         for (const auto& r : results) {
-            line.clear();
-            auto append_u64 = [&](uint64_t v) {
-                char* end = ::util::fast_uint64_to_str(v, tmp);
-                line.append(tmp, end - tmp);
-            };
-            append_u64(r.start);
-            line.push_back('-');
-            append_u64(r.end);
-            line.push_back(',');
-            append_u64(r.core_id);
-            for (uint64_t prime : r.primes) {
-                line.push_back(',');
-                append_u64(prime);
-            }
-            line.push_back('\n');
-            out.write(line.data(), line.size()).get();
+            sink.append_task(format, r.start, r.end, r.core_id, r.primes);
+        }
+        sink.close();
+        prime_seastar_output::write_index(path, format, sink.index());
+    }).handle_exception([path](std::exception_ptr e) {
+        try {
+            std::rethrow_exception(e);
+        } catch (const std::exception& ex) {
+            applog.error("Failed to write results to '{}': {}", path, ex.what());
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Sharded output: every core encodes its own results and writes them at their
+// prefix-summed file offsets (prime_seastar_output.hpp)
+// ---------------------------------------------------------------------------
+static seastar::future<> write_results_sharded(const std::string& path, prime_output::Format format) {
+    return prime_seastar_output::write_sharded(path, format, [](prime_seastar_output::ShardBuffer& buf) {
+        auto& local = g_results_per_core[seastar::this_shard_id()].results;
+        std::sort(local.begin(), local.end(),
+                  [](const TaskResult& a, const TaskResult& b) {
+                      return a.start < b.start;
+                  });
+        for (const auto& r : local)
+            buf.add(r.start, r.end, r.core_id, r.primes);
+        local.clear();
+    }).handle_exception([path](std::exception_ptr e) {
+        try {
+            std::rethrow_exception(e);
+        } catch (const std::exception& ex) {
+            applog.error("Failed to write results to '{}': {}", path, ex.what());
         }
-        out.flush().get();
-        out.close().get();
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Stream output: tasks were written in order during the computation; wait for
+// the reorder window to drain and close the file
+// ---------------------------------------------------------------------------
+static seastar::future<> write_results_stream(const std::string& path) {
+    return g_stream->close().then([] {
+        applog.info("Reorder buffer peaked at {} tasks", g_stream->peak_pending());
     }).handle_exception([path](std::exception_ptr e) {
         try {
             std::rethrow_exception(e);
         } catch (const std::exception& ex) {
             applog.error("Failed to write results to '{}': {}", path, ex.what());
         }
+    }).finally([] {
+        g_stream.reset();
     });
 }
 
+static const char* output_mode_name(prime_output::OutputMode mode) {
+    switch (mode) {
+    case prime_output::OutputMode::single:  return "single";
+    case prime_output::OutputMode::sharded: return "sharded";
+    case prime_output::OutputMode::stream:  return "stream";
+    case prime_output::OutputMode::mmap:    return "mmap";
+    }
+    return "unknown";
+}
+
 // ---------------------------------------------------------------------------
 // Dynamic task dispatch — lock-free atomic index, per-core result storage
 // ---------------------------------------------------------------------------
@@ -137,11 +183,19 @@ static seastar::future<> dispatch_task(unsigned core_id,
             r.start   = start;
             r.end     = end;
             r.core_id = core_id;
-            r.primes  = prime::segmented_sieve(start, end);
+            r.primes  = prime_cache::sieve(start, end);
             return r;
-        }).then([core_id](TaskResult r) mutable {
+        }).then([core_id, task_idx](TaskResult r) mutable {
             applog.debug("Core {} finished [{}, {}): {} primes found",
                          core_id, r.start, r.end, r.primes.size());
+            if (g_stream) {
+                // Hand the task to core 0 in task order; blocks while the reorder window is full
+                auto& stats = g_results_per_core[core_id];
+                ++stats.streamed_tasks;
+                stats.streamed_primes += r.primes.size();
+                return prime_seastar_output::submit_ordered(g_stream.get(), task_idx, r.start, r.end, r.core_id, r.primes)
+                    .then([] { return seastar::stop_iteration::no; });
+            }
             // C2: per-core result — no mutex
             g_results_per_core[core_id].results.push_back(std::move(r));
             return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::no);
@@ -169,7 +223,7 @@ static std::vector<TaskResult> merge_results(unsigned num_cores) {
 // ---------------------------------------------------------------------------
 // Application entry point (runs on shard 0 after Seastar initialises)
 // ---------------------------------------------------------------------------
-static seastar::future<>
+static seastar::future<int>
 app_main(const boost::program_options::variables_map& cfg) {
 
     // --- Read parameters ---
@@ -183,7 +237,7 @@ app_main(const boost::program_options::variables_map& cfg) {
         int chunk = cfg["chunk"].as<int>();
         if (tasks <= 0 || chunk <= 0) {
             applog.error("tasks and chunk must be positive; aborting");
-            return seastar::make_ready_future<>();
+            return seastar::make_ready_future<int>(1);
         }
         range_start = 2;
         range_end = static_cast<uint64_t>(tasks) * chunk;
@@ -204,9 +258,34 @@ app_main(const boost::program_options::variables_map& cfg) {
         out_path = "primes.csv";
     }
 
+    prime_output::Format format = prime_output::Format::csv;
+    if (!prime_output::parse_format(cfg["format"].as<std::string>(), format)) [[unlikely]] {
+        applog.error("unknown output format '{}' (expected csv, bin or bitmap); aborting", cfg["format"].as<std::string>());
+        return seastar::make_ready_future<int>(1);
+    }
+    if (cfg["output"].defaulted()) {
+        out_path = prime_output::with_extension(out_path, format);
+    }
+
+    prime_output::OutputMode mode = prime_output::OutputMode::sharded;
+    if (!prime_output::parse_output_mode(cfg["output-mode"].as<std::string>(), mode) ||
+        mode == prime_output::OutputMode::mmap) [[unlikely]] {
+        applog.error("unknown output mode '{}' (expected sharded, single or stream); aborting", cfg["output-mode"].as<std::string>());
+        return seastar::make_ready_future<int>(1);
+    }
+    const std::string cache_dir = cfg["cache-dir"].as<std::string>();
+    if (!cache_dir.empty()) {
+        g_cache = std::make_unique<prime_cache::Cache>();
+        if (!g_cache->open(cache_dir)) {
+            applog.error("cannot use cache directory {}; aborting", g_cache->error());
+            return seastar::make_ready_future<int>(1);
+        }
+        prime_cache::install(g_cache.get());
+    }
+
     if (range_start >= range_end) [[unlikely]] {
         applog.error("range-start ({}) must be strictly less than range-end ({}); aborting", range_start, range_end);
-        return seastar::make_ready_future<>();
+        return seastar::make_ready_future<int>(1);
     }
 
     if (interval == 0) [[unlikely]] {
@@ -214,6 +293,16 @@ app_main(const boost::program_options::variables_map& cfg) {
         interval = 100'000;
     }
 
+    // The bitmap file always starts at 0 and each task must own whole bytes,
+    // so task boundaries have to fall on multiples of 16.
+    if (format == prime_output::Format::bitmap) {
+        if (range_start >= prime_output::kBitmapAlign || !prime_output::bitmap_compatible(interval)) [[unlikely]] {
+            applog.error("bitmap format needs range-start < 16 and an interval that is a multiple of 16; aborting");
+            return seastar::make_ready_future<int>(1);
+        }
+        range_start = 0;
+    }
+
     uint64_t total_numbers = range_end - range_start;
     size_t num_tasks = (total_numbers + interval - 1) / interval;
 
@@ -223,37 +312,54 @@ app_main(const boost::program_options::variables_map& cfg) {
     unsigned num_cores = seastar::smp::count;
 
     for (size_t i = 0; i < num_cores; ++i)
-        g_results_per_core[i].results.clear();
-
-    applog.info("Dispatching across {} cores; total tasks: {}", num_cores, num_tasks);
+        g_results_per_core[i] = PaddedResults{};
 
-    std::vector<seastar::future<>> futures;
-    futures.reserve(num_cores);
-    for (unsigned c = 0; c < num_cores; ++c) {
-        futures.push_back(seastar::smp::submit_to(c, [c, range_start, range_end, interval, num_tasks]() {
-            return dispatch_task(c, range_start, range_end, interval, num_tasks);
-        }));
+    // Stream mode: the writer must be open before the first task completes
+    auto opened = seastar::make_ready_future<>();
+    if (mode == prime_output::OutputMode::stream) {
+        g_stream = std::make_unique<prime_seastar_output::OrderedStream>();
+        opened = g_stream->open(out_path, format, prime_output::default_reorder_window(num_cores));
     }
 
+    applog.info("Dispatching across {} cores; total tasks: {}", num_cores, num_tasks);
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    return seastar::when_all(futures.begin(), futures.end())
-    .then([out_path, start_time, num_cores, num_tasks, range_end](std::vector<seastar::future<>>) mutable {
+    return opened.then([num_cores, range_start, range_end, interval, num_tasks] {
+        std::vector<seastar::future<>> futures;
+        futures.reserve(num_cores);
+        for (unsigned c = 0; c < num_cores; ++c) {
+            futures.push_back(seastar::smp::submit_to(c, [c, range_start, range_end, interval, num_tasks]() {
+                return dispatch_task(c, range_start, range_end, interval, num_tasks);
+            }));
+        }
+        return seastar::when_all(futures.begin(), futures.end());
+    })
+    .then([out_path, format, mode, start_time, num_cores, num_tasks, range_end](std::vector<seastar::future<>>) mutable {
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-        // Merge per-core results
-        auto all_results = merge_results(num_cores);
-
-        // Compute stats before moving results
+        // Compute stats while results are still on their cores
         size_t total_primes = 0;
-        for (const auto& r : all_results)
-            total_primes += r.primes.size();
-        size_t all_size = all_results.size();
+        size_t all_size = 0;
+        for (unsigned i = 0; i < num_cores; ++i) {
+            all_size += g_results_per_core[i].results.size() + g_results_per_core[i].streamed_tasks;
+            for (const auto& r : g_results_per_core[i].results)
+                total_primes += r.primes.size();
+            total_primes += g_results_per_core[i].streamed_primes;
+        }
         uint64_t max_range = range_end;
 
-        applog.info("All cores finished. Writing {} results.", all_size);
-        return write_results_csv_async(out_path, std::move(all_results))
+        applog.info("All cores finished. Writing {} results ({} output).", all_size, output_mode_name(mode));
+        seastar::future<> written = seastar::make_ready_future<>();
+        if (mode == prime_output::OutputMode::stream) {
+            written = write_results_stream(out_path);
+        } else if (mode == prime_output::OutputMode::sharded) {
+            written = write_results_sharded(out_path, format);
+        } else {
+            written = write_results_async(out_path, format, merge_results(num_cores));
+        }
+        return written
         .then([duration, num_tasks, all_size, total_primes, max_range]() {
             std::cout << "\n========================================" << std::endl;
             std::cout << "          计算结果统计" << std::endl;
@@ -278,7 +384,7 @@ app_main(const boost::program_options::variables_map& cfg) {
 
             return seastar::make_ready_future<>();
         });
-    });
+    }).then([] { return 0; });
 }
 
 // ---------------------------------------------------------------------------
@@ -291,7 +397,13 @@ int main(int argc, char** argv) {
     opts
         ("tasks,t", boost::program_options::value<int>()->default_value(4), "Number of tasks")
         ("chunk,n", boost::program_options::value<int>()->default_value(100000), "Size of each partition (max 100000)")
-        ("output,o", boost::program_options::value<std::string>()->default_value("primes.csv"), "Path for the output CSV file")
+        ("output,o", boost::program_options::value<std::string>()->default_value("primes.csv"), "Path for the output file (.bin/.bitmap default for --format=bin/bitmap)")
+        ("format,f", boost::program_options::value<std::string>()->default_value("csv"), "Output format: csv, bin or bitmap")
+        ("output-mode", boost::program_options::value<std::string>()->default_value("sharded"),
+         "sharded: every core writes its own results at precomputed offsets; single: merge onto core 0 and stream; "
+         "stream: write tasks in order while computing, through a bounded reorder buffer")
+        ("cache-dir", boost::program_options::value<std::string>()->default_value(""),
+         "Persistent prime cache directory: cached blocks are mmapped, the rest sieved and stored (off by default)")
         ("range-start",
          boost::program_options::value<uint64_t>()->default_value(2),
          "Inclusive lower bound of the prime search range (legacy)")
@@ -303,6 +415,12 @@ int main(int argc, char** argv) {
          "Width of each sub-task interval (clamped to 100,000) (legacy)");
 
     return app.run(argc, argv, [&app]() {
-        return app_main(app.configuration());
+        return app_main(app.configuration()).then([](int status) {
+            if (status == 0 && g_cache) {
+                applog.info("prime cache: {} blocks mapped, {} sieved ({})",
+                            g_cache->hits(), g_cache->misses(), g_cache->dir());
+            }
+            return status;
+        });
     });
 }